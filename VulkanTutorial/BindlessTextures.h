@@ -0,0 +1,176 @@
+//
+//  BindlessTextures.h
+//  VulkanTutorial
+//
+
+#ifndef BindlessTextures_h
+#define BindlessTextures_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// Bindless texture registry
+// Every texture is one element of a single sampler2D array in a set of its own (binding 0), which stays bound for
+// the whole frame. A texture is added once and keeps its slot; materials hand the slot to the shader
+// (shader/Bindless.frag reads it from a push constant), so switching textures never binds another descriptor set.
+// Needs descriptor indexing (core in Vulkan 1.2):
+//  PARTIALLY_BOUND: slots that were never written, or were removed, are fine as long as no draw reads them
+//  UPDATE_AFTER_BIND + UPDATE_UNUSED_WHILE_PENDING: new slots are written while frames using the set are in flight
+//  VARIABLE_DESCRIPTOR_COUNT: the array is sized when the set is allocated instead of in the layout
+class BindlessTextures
+{
+public:
+	static bool isSupported(const VkPhysicalDeviceDescriptorIndexingFeatures& features)
+	{
+		return features.runtimeDescriptorArray && features.descriptorBindingPartiallyBound &&
+			features.descriptorBindingVariableDescriptorCount && features.descriptorBindingSampledImageUpdateAfterBind &&
+			features.descriptorBindingUpdateUnusedWhilePending;
+	}
+
+	// Largest array a single stage can see, combined image samplers count against both the sampler and image limits
+	static uint32_t getMaxCapacity(const VkPhysicalDeviceDescriptorIndexingProperties& properties)
+	{
+		return std::min({
+			properties.maxPerStageDescriptorUpdateAfterBindSamplers,
+			properties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			properties.maxPerStageUpdateAfterBindResources,
+			properties.maxDescriptorSetUpdateAfterBindSamplers,
+			properties.maxDescriptorSetUpdateAfterBindSampledImages
+		});
+	}
+
+	void create(VkDevice device, uint32_t capacity)
+	{
+		this->device = device;
+		this->capacity = capacity;
+
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.descriptorCount = capacity; // upper bound, the set is allocated with the actual size
+		binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		// The variable sized binding has to be the last one of the set
+		VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT |
+			VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = 1;
+		bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+
+		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor set layout!");
+		}
+
+		VkDescriptorPoolSize poolSize{};
+		poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		poolSize.descriptorCount = capacity;
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		poolInfo.maxSets = 1;
+
+		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create bindless descriptor pool!");
+		}
+
+		VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+		countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+		countInfo.descriptorSetCount = 1;
+		countInfo.pDescriptorCounts = &capacity;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = &countInfo;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+
+		if (vkAllocateDescriptorSets(device, &allocInfo, &set) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate bindless descriptor set!");
+		}
+	}
+
+	// The set goes with the pool
+	void destroy()
+	{
+		vkDestroyDescriptorPool(device, pool, nullptr);
+		vkDestroyDescriptorSetLayout(device, layout, nullptr);
+		freeSlots.clear();
+		slotCount = 0;
+	}
+
+	// Writes the texture to a free slot and returns it. Safe while frames are in flight, a free slot is read by none.
+	uint32_t add(VkImageView imageView, VkSampler sampler)
+	{
+		uint32_t slot;
+		if (!freeSlots.empty())
+		{
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+		}
+		else if (slotCount < capacity)
+		{
+			slot = slotCount++;
+		}
+		else
+		{
+			throw std::runtime_error("bindless texture array is full!");
+		}
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = sampler;
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = set;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = slot;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+		return slot;
+	}
+
+	// The slot is handed out again by a later add(), only remove textures no frame in flight still samples
+	void remove(uint32_t slot)
+	{
+		freeSlots.push_back(slot);
+	}
+
+	VkDescriptorSetLayout getLayout() const { return layout; }
+	VkDescriptorSet getSet() const { return set; }
+	uint32_t getCapacity() const { return capacity; }
+	uint32_t getCount() const { return slotCount - static_cast<uint32_t>(freeSlots.size()); }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	uint32_t capacity = 0;
+	uint32_t slotCount = 0; // slots ever handed out
+	std::vector<uint32_t> freeSlots;
+};
+
+#endif /* BindlessTextures_h */
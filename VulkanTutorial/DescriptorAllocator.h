@@ -0,0 +1,271 @@
+//
+//  DescriptorAllocator.h
+//  VulkanTutorial
+//
+
+#ifndef DescriptorAllocator_h
+#define DescriptorAllocator_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+// Growing descriptor set allocator
+// Sets come from a chain of pools. When a pool runs out (VK_ERROR_OUT_OF_POOL_MEMORY, or VK_ERROR_FRAGMENTED_POOL)
+// it is parked as full and the allocation is retried from the next one, which is created twice as large as the last
+// if there is none left. Sets can't be freed one by one, reset() hands every set back at once with
+// vkResetDescriptorPool and keeps the pools for the next round. One allocator per frame in flight, reset once the
+// frame's fence has signalled, makes per-frame transient descriptor sets about as cheap as a pointer bump.
+// Pool sizes are given as descriptors per set and type, averaged over the layouts the allocator will see.
+class DescriptorAllocator
+{
+public:
+	struct PoolRatio
+	{
+		VkDescriptorType type;
+		float descriptorsPerSet;
+	};
+
+	struct Stats
+	{
+		uint64_t allocations = 0;
+		uint32_t pools = 0;
+		uint32_t setCapacity = 0;
+		uint32_t descriptorCapacity = 0; // what the pools hold, drivers don't tell how many bytes that is
+	};
+
+	void create(VkDevice device, uint32_t setsPerPool, const std::vector<PoolRatio>& ratios)
+	{
+		this->device = device;
+		this->setsPerPool = setsPerPool;
+		this->ratios = ratios;
+	}
+
+	void destroy()
+	{
+		for (VkDescriptorPool pool : readyPools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		for (VkDescriptorPool pool : fullPools)
+		{
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		readyPools.clear();
+		fullPools.clear();
+	}
+
+	// Every set allocated so far becomes invalid, nothing may still use them
+	void reset()
+	{
+		for (VkDescriptorPool pool : readyPools)
+		{
+			vkResetDescriptorPool(device, pool, 0);
+		}
+		for (VkDescriptorPool pool : fullPools)
+		{
+			vkResetDescriptorPool(device, pool, 0);
+			readyPools.push_back(pool);
+		}
+		fullPools.clear();
+	}
+
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout)
+	{
+		VkDescriptorSet set;
+		VkResult result = tryAllocate(getPool(), layout, set);
+		if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+		{
+			fullPools.push_back(readyPools.back());
+			readyPools.pop_back();
+			result = tryAllocate(getPool(), layout, set);
+		}
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to allocate descriptor set!");
+		}
+
+		stats.allocations++;
+		return set;
+	}
+
+	const Stats& getStats() const { return stats; }
+
+private:
+	VkResult tryAllocate(VkDescriptorPool pool, VkDescriptorSetLayout layout, VkDescriptorSet& set) const
+	{
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &layout;
+		return vkAllocateDescriptorSets(device, &allocInfo, &set);
+	}
+
+	// The pool allocations go to, the last ready one
+	VkDescriptorPool getPool()
+	{
+		if (readyPools.empty())
+		{
+			uint32_t sets = std::min(setsPerPool << std::min(stats.pools, 6u), MAX_SETS_PER_POOL);
+
+			std::vector<VkDescriptorPoolSize> poolSizes;
+			for (const PoolRatio& ratio : ratios)
+			{
+				uint32_t count = static_cast<uint32_t>(std::ceil(ratio.descriptorsPerSet * sets));
+				poolSizes.push_back({ratio.type, count});
+				stats.descriptorCapacity += count;
+			}
+
+			VkDescriptorPoolCreateInfo poolInfo{};
+			poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+			poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+			poolInfo.pPoolSizes = poolSizes.data();
+			poolInfo.maxSets = sets;
+
+			VkDescriptorPool pool;
+			if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create descriptor pool!");
+			}
+			readyPools.push_back(pool);
+			stats.pools++;
+			stats.setCapacity += sets;
+		}
+		return readyPools.back();
+	}
+
+	static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t setsPerPool = 0;
+	std::vector<PoolRatio> ratios;
+	std::vector<VkDescriptorPool> readyPools; // the last one is allocated from
+	std::vector<VkDescriptorPool> fullPools;
+	Stats stats;
+};
+
+// Descriptor set layout cache
+// Layouts are keyed by their flags and bindings, in any order, so every place that needs "a uniform buffer for the
+// vertex stage" gets the same VkDescriptorSetLayout and pipelines built from them stay compatible. Layouts live until
+// destroy(). Immutable samplers are keyed by handle, which works with SamplerCache handing out one per configuration.
+// pNext chains (binding flags) are not part of the key and are rejected.
+class DescriptorLayoutCache
+{
+public:
+	void create(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	void destroy()
+	{
+		for (const auto& entry : layouts)
+		{
+			vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+		}
+		layouts.clear();
+	}
+
+	VkDescriptorSetLayout get(const VkDescriptorSetLayoutCreateInfo& createInfo)
+	{
+		if (createInfo.pNext != nullptr)
+		{
+			throw std::runtime_error("descriptor layout cache can't key pNext chains!");
+		}
+
+		Key key;
+		key.flags = createInfo.flags;
+		for (uint32_t i = 0; i < createInfo.bindingCount; i++)
+		{
+			const VkDescriptorSetLayoutBinding& binding = createInfo.pBindings[i];
+			Binding keyBinding{binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, {}};
+			if (binding.pImmutableSamplers != nullptr)
+			{
+				keyBinding.immutableSamplers.assign(binding.pImmutableSamplers,
+				                                    binding.pImmutableSamplers + binding.descriptorCount);
+			}
+			key.bindings.push_back(keyBinding);
+		}
+		std::sort(key.bindings.begin(), key.bindings.end(), [](const Binding& a, const Binding& b)
+		{
+			return a.binding < b.binding;
+		});
+
+		auto found = layouts.find(key);
+		if (found != layouts.end())
+		{
+			return found->second;
+		}
+
+		VkDescriptorSetLayout layout;
+		if (vkCreateDescriptorSetLayout(device, &createInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor set layout!");
+		}
+		layouts.emplace(std::move(key), layout);
+		return layout;
+	}
+
+	uint32_t getLayoutCount() const { return static_cast<uint32_t>(layouts.size()); }
+
+private:
+	struct Binding
+	{
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count;
+		VkShaderStageFlags stages;
+		std::vector<VkSampler> immutableSamplers;
+
+		bool operator==(const Binding& other) const
+		{
+			return binding == other.binding && type == other.type && count == other.count &&
+				stages == other.stages && immutableSamplers == other.immutableSamplers;
+		}
+	};
+
+	struct Key
+	{
+		VkDescriptorSetLayoutCreateFlags flags = 0;
+		std::vector<Binding> bindings;
+
+		bool operator==(const Key& other) const
+		{
+			return flags == other.flags && bindings == other.bindings;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			size_t hash = key.flags;
+			auto combine = [&hash](size_t value)
+			{
+				hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+			};
+			for (const Binding& binding : key.bindings)
+			{
+				combine(binding.binding);
+				combine(binding.type);
+				combine(binding.count);
+				combine(binding.stages);
+				for (VkSampler sampler : binding.immutableSamplers)
+				{
+					combine(std::hash<VkSampler>()(sampler));
+				}
+			}
+			return hash;
+		}
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> layouts;
+};
+
+#endif /* DescriptorAllocator_h */
@@ -0,0 +1,119 @@
+//
+//  DescriptorWriter.h
+//  VulkanTutorial
+//
+
+#ifndef DescriptorWriter_h
+#define DescriptorWriter_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <stdexcept>
+
+// Descriptor writes through update templates
+// Built from the same bindings as the set layout, the template knows where every descriptor of the set lives in a
+// packed array of Descriptor, one per descriptor in binding order (arrays take descriptorCount in a row). Writing a
+// set is then one call that reads the array, instead of a VkWriteDescriptorSet per binding the driver has to walk.
+// With VK_KHR_push_descriptor the same array can be pushed straight into a command buffer, for layouts created with
+// VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR. Those can't hold dynamic uniform or storage buffers,
+// the offset goes into the pushed VkDescriptorBufferInfo instead.
+class DescriptorWriter
+{
+public:
+	// One slot of the packed array, which member depends on the binding's type
+	union Descriptor
+	{
+		VkDescriptorImageInfo image;
+		VkDescriptorBufferInfo buffer;
+		VkBufferView texelBuffer;
+	};
+
+	void create(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	            VkDescriptorSetLayout layout)
+	{
+		VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+		templateInfo.descriptorSetLayout = layout;
+		createTemplate(device, bindings, templateInfo);
+	}
+
+	// push is vkCmdPushDescriptorSetWithTemplateKHR, fetched with vkGetDeviceProcAddr
+	void createPush(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	                VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set,
+	                PFN_vkCmdPushDescriptorSetWithTemplateKHR push)
+	{
+		VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+		templateInfo.pipelineBindPoint = bindPoint;
+		templateInfo.pipelineLayout = pipelineLayout;
+		templateInfo.set = set;
+		this->pipelineLayout = pipelineLayout;
+		this->set = set;
+		this->pushDescriptorSet = push;
+		createTemplate(device, bindings, templateInfo);
+	}
+
+	void destroy()
+	{
+		if (updateTemplate != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorUpdateTemplate(device, updateTemplate, nullptr);
+			updateTemplate = VK_NULL_HANDLE;
+		}
+	}
+
+	// descriptors: getDescriptorCount() of them, the set must not be in use
+	void update(VkDescriptorSet descriptorSet, const Descriptor* descriptors) const
+	{
+		vkUpdateDescriptorSetWithTemplate(device, descriptorSet, updateTemplate, descriptors);
+	}
+
+	// Only for writers made with createPush(), the descriptors are copied into the command buffer
+	void push(VkCommandBuffer commandBuffer, const Descriptor* descriptors) const
+	{
+		pushDescriptorSet(commandBuffer, updateTemplate, pipelineLayout, set, descriptors);
+	}
+
+	uint32_t getDescriptorCount() const { return descriptorCount; }
+
+private:
+	void createTemplate(VkDevice device, const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	                    VkDescriptorUpdateTemplateCreateInfo& templateInfo)
+	{
+		this->device = device;
+
+		std::vector<VkDescriptorUpdateTemplateEntry> entries;
+		descriptorCount = 0;
+		for (const VkDescriptorSetLayoutBinding& binding : bindings)
+		{
+			if (binding.descriptorCount == 0) continue;
+
+			VkDescriptorUpdateTemplateEntry entry{};
+			entry.dstBinding = binding.binding;
+			entry.dstArrayElement = 0;
+			entry.descriptorCount = binding.descriptorCount;
+			entry.descriptorType = binding.descriptorType;
+			entry.offset = descriptorCount * sizeof(Descriptor);
+			entry.stride = sizeof(Descriptor);
+			entries.push_back(entry);
+			descriptorCount += binding.descriptorCount;
+		}
+
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+		templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		templateInfo.pDescriptorUpdateEntries = entries.data();
+		if (vkCreateDescriptorUpdateTemplate(device, &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create descriptor update template!");
+		}
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+	uint32_t descriptorCount = 0;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	uint32_t set = 0;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR pushDescriptorSet = nullptr;
+};
+
+#endif /* DescriptorWriter_h */
@@ -14,12 +14,29 @@
 #include "Utils.h"
 #include <chrono>
 
+// stb_image picks its SSE2 JPEG kernels (IDCT, chroma upsampling, YCbCr -> RGB) by itself on x86,
+// the NEON versions only when asked to. The color conversion one needs 4 channel output, which is all we ask for.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define STBI_NEON
+#endif
+// Allocations go through TextureDecoder so an image can be decoded straight into a staging buffer
+#define STBI_MALLOC(size) TextureDecoder::allocate(size)
+#define STBI_REALLOC(pointer, size) TextureDecoder::reallocate(pointer, size)
+#define STBI_FREE(pointer) TextureDecoder::release(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
+#include <glm/gtc/packing.hpp>
+
 void HelloTriangleApplication::initWindow()
 {
 	glfwInit();
@@ -29,6 +46,7 @@ void HelloTriangleApplication::initWindow()
 
 	glfwSetWindowUserPointer(window, this);
 	glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+	glfwSetKeyCallback(window, keyCallback);
 }
 
 void HelloTriangleApplication::initVulkan()
@@ -38,10 +56,19 @@ void HelloTriangleApplication::initVulkan()
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	createSamplerCache();
+	createDescriptorLayoutCache();
+	createShaderCompiler();
+	createShaderReflection();
+	createPipelineLibrary();
 	createSwapChain();
 	createImageViews();
 	createRenderPass();
+	loadVirtualTexture();
 	createDescriptorSetLayout();
+	createBindlessTextures();
+	// 3d model, loaded before the pipeline since the mesh picks the vertex layout
+	loadModel();
 	createGraphicsPipeline();
 	createCommandPool();
 	// depth and msaa
@@ -50,27 +77,74 @@ void HelloTriangleApplication::initVulkan()
 	createFramebuffers();
 
 	// texture
+	createDownsamplePipeline();
 	createTextureImage();
 	createTextureImageView();
 	createTextureSampler();
+	createTextureStreaming();
+	createVirtualTextureResources();
+	if (BENCHMARK_MIPMAPS)
+	{
+		benchmarkMipmaps();
+	}
+	if (BENCHMARK_UPLOAD)
+	{
+		benchmarkUpload();
+	}
 
 	// 3d model
-	loadModel();
 	createVertexBuffer();
 	createIndexBuffer();
 	createUniformBuffers();
-	createDescriptorPool();
+	createDescriptorAllocators();
 	createDescriptorSets();
+	if (BENCHMARK_BINDLESS)
+	{
+		benchmarkMaterials();
+	}
+	if (BENCHMARK_SAMPLERS)
+	{
+		benchmarkSamplers();
+	}
+	if (BENCHMARK_UNIFORMS)
+	{
+		benchmarkUniforms();
+	}
+	if (BENCHMARK_PUSH_CONSTANTS)
+	{
+		benchmarkPushConstants();
+	}
+	if (BENCHMARK_DESCRIPTOR_UPDATES)
+	{
+		benchmarkDescriptorUpdates();
+	}
+	if (BENCHMARK_PIPELINE_PERMUTATIONS)
+	{
+		benchmarkPipelinePermutations();
+	}
+	if (BENCHMARK_SHADER_REFLECTION)
+	{
+		benchmarkShaderReflection();
+	}
 	createCommandBuffers();
 	createSyncObjects();
+	createStatisticsQueryPool();
+	if (BENCHMARK_SHADER_VARIANTS)
+	{
+		startVariantBenchmark();
+	}
 }
 
 void HelloTriangleApplication::mainLoop()
 {
+	frameStats.lastFrame = std::chrono::high_resolution_clock::now();
+	frameStats.lastReport = frameStats.lastFrame;
+
 	while (!glfwWindowShouldClose(window))
 	{
 		glfwPollEvents();
 		drawFrame();
+		updateFrameStats();
 	}
 	vkDeviceWaitIdle(device);
 }
@@ -82,20 +156,33 @@ void HelloTriangleApplication::cleanup()
 		DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
 	}
 	destroyDepthResources();
+	destroyStatisticsQueryPool();
+	if (variantBenchmark.queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, variantBenchmark.queryPool, nullptr);
+	}
 	destroySyncObjects();
 	destroyCommandPool();
 	cleanupSwapChain();
-	destroyTextureSampler();
 	destroyTextureImageView();
 	destroyTextureImage();
+	destroyTextureStreaming();
+	destroyVirtualTexture();
+	destroyDownsamplePipeline();
 	destroyUniformBuffers();
-	destroyDescriptorPool();
-	destroyDescriptorSetLayout();
+	destroyDescriptorAllocators();
+	destroyBindlessTextures();
 	destroyIndexBuffer();
 	destroyVertexBuffer();
 	destroyGraphicsPipeline();
+	destroyPipelineLibrary();
+	destroyShaderCompiler();
+	destroyShaderReflection();
 	destroyRenderPass();
 	destroySwapChain();
+	descriptorWriter.destroy();
+	destroyDescriptorLayoutCache();
+	destroySamplerCache();
 	destroyDevice();
 	destroySurface();
 	destroyInstance();
@@ -116,7 +203,7 @@ void HelloTriangleApplication::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_2; // descriptor indexing is core from 1.2 on
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -226,6 +313,9 @@ void HelloTriangleApplication::createLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	VkDeviceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -234,9 +324,156 @@ void HelloTriangleApplication::createLogicalDevice()
 	createInfo.pEnabledFeatures = &deviceFeatures;
 	deviceFeatures.samplerAnisotropy = VK_TRUE; // enable anisotropy
 	deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
+	// optional, textures stay uncompressed without it
+	textureCompressionBCSupported = supportedFeatures.textureCompressionBC == VK_TRUE;
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+	// optional, the frame stats just leave out the GPU counters without it
+	pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery == VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery = supportedFeatures.pipelineStatisticsQuery;
+	// optional, the compute downsampler indexes its per level storage views, mipmaps are blitted without it.
+	// The texture's sRGB view leaves out the storage usage of its UNORM image, which takes Vulkan 1.1.
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	computeMipmapsSupported = COMPUTE_MIPMAPS && deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		supportedFeatures.shaderStorageImageArrayDynamicIndexing == VK_TRUE;
+	deviceFeatures.shaderStorageImageArrayDynamicIndexing = supportedFeatures.shaderStorageImageArrayDynamicIndexing;
+
+	// optional, the virtual texture's feedback is written from the fragment shader
+	fragmentStoresSupported = supportedFeatures.fragmentStoresAndAtomics == VK_TRUE;
+	deviceFeatures.fragmentStoresAndAtomics = supportedFeatures.fragmentStoresAndAtomics;
+
+	// optional, bindless textures need Vulkan 1.2 descriptor indexing, the model is drawn with set 0's sampler without it
+	VkPhysicalDeviceDescriptorIndexingFeatures supportedIndexingFeatures{};
+	supportedIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	if (BINDLESS_TEXTURES && deviceProperties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supportedIndexingFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	}
+	// The per stage limits also count the sampler in set 0
+	bindlessTextureCapacity = std::min(BINDLESS_TEXTURE_CAPACITY,
+	                                   std::max(BindlessTextures::getMaxCapacity(indexingProperties), 1u) - 1);
+	bindlessTexturesSupported = BindlessTextures::isSupported(supportedIndexingFeatures) &&
+		supportedFeatures.shaderSampledImageArrayDynamicIndexing == VK_TRUE && bindlessTextureCapacity > 0;
+	const std::string& bindlessShaderPath = getShaderPath(BINDLESS_FRAG_SHADER_SOURCE, BINDLESS_FRAG_SHADER_PATH);
+	if (bindlessTexturesSupported && TutUtils::getFileStamp(bindlessShaderPath) == 0)
+	{
+		std::cout << bindlessShaderPath << " not found (see compile_shader.bat), textures are bound one at a time"
+			<< std::endl;
+		bindlessTexturesSupported = false;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+	if (bindlessTexturesSupported)
+	{
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+		indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+		indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+		indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+		indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+		createInfo.pNext = &indexingFeatures;
+	}
+
+	// optional, the texture streamer keeps to its own budget without it
+	memoryBudgetSupported = TEXTURE_STREAMING && deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		isDeviceExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	std::vector<const char*> enabledExtensions = deviceExtensions;
+	if (memoryBudgetSupported)
+	{
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	// optional, only the descriptor update benchmark pushes descriptors
+	pushDescriptorsSupported = BENCHMARK_DESCRIPTOR_UPDATES &&
+		isDeviceExtensionSupported(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+	if (pushDescriptorsSupported)
+	{
+		enabledExtensions.push_back(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME);
+	}
+
+	// optional, pipelines carry all their state and are created whole without them
+	// Extended dynamic state 3 is only used for the polygon mode, blend enable and write mask
+	bool dynamicStateExtension = DYNAMIC_PIPELINE_STATE && deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		isDeviceExtensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+	bool dynamicState3Extension = DYNAMIC_PIPELINE_STATE && deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		isDeviceExtensionSupported(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+	bool pipelineLibraryExtension = PIPELINE_LIBRARIES && deviceProperties.apiVersion >= VK_API_VERSION_1_1 &&
+		isDeviceExtensionSupported(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+		isDeviceExtensionSupported(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT dynamicStateFeatures{};
+	dynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT dynamicState3Features{};
+	dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures{};
+	pipelineLibraryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+	if (dynamicStateExtension || dynamicState3Extension || pipelineLibraryExtension)
+	{
+		// Only structs of supported extensions may be chained
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		if (dynamicStateExtension)
+		{
+			dynamicStateFeatures.pNext = features2.pNext;
+			features2.pNext = &dynamicStateFeatures;
+		}
+		if (dynamicState3Extension)
+		{
+			dynamicState3Features.pNext = features2.pNext;
+			features2.pNext = &dynamicState3Features;
+		}
+		if (pipelineLibraryExtension)
+		{
+			pipelineLibraryFeatures.pNext = features2.pNext;
+			features2.pNext = &pipelineLibraryFeatures;
+		}
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+	}
+	pipelineFeatures.extendedDynamicState = dynamicStateExtension && dynamicStateFeatures.extendedDynamicState == VK_TRUE;
+	pipelineFeatures.extendedDynamicState3 = dynamicState3Extension &&
+		dynamicState3Features.extendedDynamicState3PolygonMode == VK_TRUE &&
+		dynamicState3Features.extendedDynamicState3ColorBlendEnable == VK_TRUE &&
+		dynamicState3Features.extendedDynamicState3ColorWriteMask == VK_TRUE;
+	pipelineFeatures.graphicsPipelineLibrary = pipelineLibraryExtension &&
+		pipelineLibraryFeatures.graphicsPipelineLibrary == VK_TRUE;
+
+	// The queried structs become the enabled ones, with just the features used
+	if (pipelineFeatures.extendedDynamicState)
+	{
+		enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+		dynamicStateFeatures.pNext = const_cast<void*>(createInfo.pNext);
+		createInfo.pNext = &dynamicStateFeatures;
+	}
+	if (pipelineFeatures.extendedDynamicState3)
+	{
+		enabledExtensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		dynamicState3Features = {};
+		dynamicState3Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT;
+		dynamicState3Features.extendedDynamicState3PolygonMode = VK_TRUE;
+		dynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE;
+		dynamicState3Features.extendedDynamicState3ColorWriteMask = VK_TRUE;
+		dynamicState3Features.pNext = const_cast<void*>(createInfo.pNext);
+		createInfo.pNext = &dynamicState3Features;
+	}
+	if (pipelineFeatures.graphicsPipelineLibrary)
+	{
+		enabledExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		enabledExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		pipelineLibraryFeatures.pNext = const_cast<void*>(createInfo.pNext);
+		createInfo.pNext = &pipelineLibraryFeatures;
+	}
 
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	if (enableValidationLayers)
 	{
@@ -255,6 +492,12 @@ void HelloTriangleApplication::createLogicalDevice()
 	// retrieving queue handles
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+	if (pushDescriptorsSupported)
+	{
+		cmdPushDescriptorSetWithTemplate = reinterpret_cast<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+			vkGetDeviceProcAddr(device, "vkCmdPushDescriptorSetWithTemplateKHR"));
+	}
 }
 
 void HelloTriangleApplication::destroyDevice()
@@ -440,6 +683,197 @@ void HelloTriangleApplication::destroyImageViews()
 	}
 }
 
+void HelloTriangleApplication::createShaderCompiler()
+{
+	shaderCompiler.create(SHADER_CACHE_DIRECTORY, SHADER_HOT_RELOAD);
+}
+
+void HelloTriangleApplication::destroyShaderCompiler()
+{
+	const ShaderCompiler::Stats& stats = shaderCompiler.getStats();
+	std::cout << "shaders: " << stats.requests << " loaded, " << stats.cacheHits << " from the cache, "
+		<< stats.compiled << " compiled in " << stats.compileTime << " ms" << std::endl;
+	shaderCompiler.destroy();
+}
+
+void HelloTriangleApplication::createShaderReflection()
+{
+	shaderReflection.create(device);
+}
+
+void HelloTriangleApplication::destroyShaderReflection()
+{
+	const ShaderReflection::Stats& stats = shaderReflection.getStats();
+	std::cout << "shader reflection: " << stats.requests << " requests, " << stats.parsed << " modules parsed in "
+		<< stats.parseTime << " ms, " << shaderReflection.getPipelineLayoutCount() << " pipeline layouts" << std::endl;
+	shaderReflection.destroy();
+}
+
+const ShaderReflection::Module& HelloTriangleApplication::reflectShader(const std::string& path,
+                                                                        const std::vector<std::string>& defines)
+{
+	return shaderReflection.reflect(shaderCompiler.load(path, defines));
+}
+
+// Every shader that runs with pipelineLayout, so set 0 and the push constant range cover all of them
+std::vector<const ShaderReflection::Module*> HelloTriangleApplication::getPipelineLayoutShaders()
+{
+	std::vector<const ShaderReflection::Module*> shaders = {
+		&reflectShader(getShaderPath(VERTEX_SHADER_SOURCE, VERTEX_SHADER_PATH)),
+		&reflectShader(getShaderPath(DEPTH_SHADER_SOURCE, DEPTH_SHADER_PATH)),
+		&reflectShader(getShaderPath(FRAG_SHADER_SOURCE, FRAG_SHADER_PATH))
+	};
+	if (bindlessTexturesSupported)
+	{
+		shaders.push_back(&reflectShader(getShaderPath(BINDLESS_FRAG_SHADER_SOURCE, BINDLESS_FRAG_SHADER_PATH)));
+	}
+	if (virtualTextureEnabled)
+	{
+		shaders.push_back(&reflectShader(getShaderPath(VIRTUAL_TEXTURE_SHADER_SOURCE, VIRTUAL_TEXTURE_SHADER_PATH)));
+	}
+	// The uber shader reads the features from the push constants
+	if (BENCHMARK_SHADER_VARIANTS && getShaderPath(FRAG_SHADER_SOURCE, FRAG_SHADER_PATH) == FRAG_SHADER_SOURCE)
+	{
+		shaders.push_back(&reflectShader(FRAG_SHADER_SOURCE, {"UBER_SHADER"}));
+	}
+	return shaders;
+}
+
+void HelloTriangleApplication::benchmarkShaderReflection()
+{
+	// The app's shaders over and over, as many modules as a bigger renderer would have at startup. Parsing is timed
+	// on its own, then reflect() and the layouts through the caches, which only build what they haven't seen.
+	const std::array<std::pair<const std::string&, const std::string&>, 5> shaders = {{
+		{VERTEX_SHADER_SOURCE, VERTEX_SHADER_PATH},
+		{DEPTH_SHADER_SOURCE, DEPTH_SHADER_PATH},
+		{FRAG_SHADER_SOURCE, FRAG_SHADER_PATH},
+		{BINDLESS_FRAG_SHADER_SOURCE, BINDLESS_FRAG_SHADER_PATH},
+		{VIRTUAL_TEXTURE_SHADER_SOURCE, VIRTUAL_TEXTURE_SHADER_PATH}
+	}};
+	std::vector<std::vector<char>> shaderCode;
+	for (const auto& shader : shaders)
+	{
+		const std::string& path = getShaderPath(shader.first, shader.second);
+		// Not every .spv is there without runtime compilation
+		if (TutUtils::getFileStamp(path) != 0)
+		{
+			shaderCode.push_back(shaderCompiler.load(path));
+		}
+	}
+
+	const uint32_t moduleCount = SHADER_REFLECTION_BENCHMARK_MODULES;
+	size_t bytes = 0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < moduleCount; i++)
+	{
+		const std::vector<char>& code = shaderCode[i % shaderCode.size()];
+		ShaderReflection::parse(code.data(), code.size());
+		bytes += code.size();
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	double parseTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+	// A reflection of its own, so the app's caches don't count the benchmark
+	ShaderReflection reflection;
+	reflection.create(device);
+	start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < moduleCount; i++)
+	{
+		const ShaderReflection::Module& module = reflection.reflect(shaderCode[i % shaderCode.size()]);
+		std::vector<VkDescriptorSetLayoutBinding> bindings = ShaderReflection::getSetBindings({&module}, 0);
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		VkDescriptorSetLayout setLayout = descriptorLayoutCache.get(layoutInfo);
+		reflection.getPipelineLayout({setLayout}, ShaderReflection::getPushConstantRange({&module}));
+	}
+	end = std::chrono::high_resolution_clock::now();
+	double cachedTime = std::chrono::duration<double, std::milli>(end - start).count();
+
+	std::cout << "shader reflection benchmark: " << moduleCount << " modules, " << bytes / 1024 << " KB of SPIR-V"
+		<< std::endl;
+	std::cout << "  parse: " << parseTime << " ms, " << parseTime * 1000.0 / moduleCount << " us per module, "
+		<< bytes / 1048576.0 / (parseTime / 1000.0) << " MB/s" << std::endl;
+	std::cout << "  reflect + layouts through the caches: " << cachedTime << " ms, "
+		<< cachedTime * 1000.0 / moduleCount << " us per module, " << reflection.getStats().parsed
+		<< " modules parsed, " << reflection.getPipelineLayoutCount() << " pipeline layouts created" << std::endl;
+	reflection.destroy();
+}
+
+const std::string& HelloTriangleApplication::getShaderPath(const std::string& source, const std::string& binary) const
+{
+	return RUNTIME_SHADERS && ShaderCompiler::isAvailable() ? source : binary;
+}
+
+// Called between frames, once the frame's fence has signalled
+void HelloTriangleApplication::reloadChangedShaders()
+{
+	std::vector<std::string> changed = shaderCompiler.getChangedSources();
+	if (changed.empty()) return;
+
+	bool waited = false;
+	for (const std::string& source : changed)
+	{
+		if (!pipelineLibrary.usesShader(source)) continue;
+
+		// A source that doesn't compile keeps the pipelines from the last one that did.
+		// Every define set the library holds is tried, so a variant can't break after the old one is dropped.
+		try
+		{
+			for (const std::vector<std::string>& defines : pipelineLibrary.getShaderDefines(source))
+			{
+				shaderCompiler.load(source, defines);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "shader reload: " << source << ": " << e.what() << std::endl;
+			continue;
+		}
+
+		if (!waited)
+		{
+			vkDeviceWaitIdle(device);
+			waited = true;
+		}
+		uint32_t dropped = pipelineLibrary.reloadShader(source);
+		std::cout << "shader reload: " << source << ", " << dropped << " pipelines dropped" << std::endl;
+	}
+	if (!waited) return;
+
+	// The compiled SPIR-V is in the cache by now
+	auto start = std::chrono::high_resolution_clock::now();
+	graphicsPipeline = pipelineLibrary.get(colorPassDescription);
+	depthEqualPipeline = pipelineLibrary.get(depthEqualDescription);
+	depthPrepassPipeline = pipelineLibrary.get(depthPrepassDescription);
+	auto end = std::chrono::high_resolution_clock::now();
+	std::cout << "shader reload: pipelines rebuilt in " << std::chrono::duration<double, std::milli>(end - start).count()
+		<< " ms" << std::endl;
+}
+
+void HelloTriangleApplication::createPipelineLibrary()
+{
+	std::vector<char> cacheData;
+	if (TutUtils::getFileStamp(PIPELINE_CACHE_PATH) != 0)
+	{
+		cacheData = TutUtils::readFile(PIPELINE_CACHE_PATH);
+	}
+	pipelineLibrary.create(device, cacheData, TutUtils::getWorkerCount(), pipelineFeatures,
+	                       [this](const std::string& path, const std::vector<std::string>& defines)
+	                       {
+		                       return shaderCompiler.load(path, defines);
+	                       });
+}
+
+void HelloTriangleApplication::destroyPipelineLibrary()
+{
+	std::vector<char> cacheData = pipelineLibrary.getCacheData();
+	std::ofstream file(PIPELINE_CACHE_PATH, std::ios::binary);
+	file.write(cacheData.data(), static_cast<std::streamsize>(cacheData.size()));
+	pipelineLibrary.destroy();
+}
+
 // 1. Shader stages: the shader modules that define the functionality of the programmable stages of the graphics pipeline
 // 2. Fixed-function state: all of the structures that define the fixed-function stages of the pipeline, like input assembly, rasterizer, viewport and color blending
 // 3. Pipeline layout: the uniform and push values referenced by the shader that can be updated at draw time
@@ -447,179 +881,372 @@ void HelloTriangleApplication::destroyImageViews()
 
 void HelloTriangleApplication::createGraphicsPipeline()
 {
-	// Shader
-	auto vertShaderCode = TutUtils::readFile(VERTEX_SHADER_PATH);
-	auto fragShaderCode = TutUtils::readFile(FRAG_SHADER_PATH);
+	// Pipeline layout
+	// Bindless: set 1 holds every texture and the material in the push constants tells the fragment shader which one
+	// to sample. The vertex stage gets the model matrix from the same push constants.
+	// Set 1 is bindlessTextures' own layout, it needs binding flags the reflection knows nothing of.
+	std::vector<const ShaderReflection::Module*> shaders = getPipelineLayoutShaders();
+	std::vector<VkDescriptorSetLayout> setLayouts = {descriptorSetLayout, bindlessTextures.getLayout()};
+	uint32_t setCount = ShaderReflection::getSetCount(shaders);
+	if (setCount > setLayouts.size())
+	{
+		throw std::runtime_error("shaders use more descriptor sets than the pipeline layout has!");
+	}
+	setLayouts.resize(setCount);
+
+	// DrawConstants is pushed up to where the shaders stop reading it, 72 bytes at most, maxPushConstantsSize is at
+	// least 128
+	drawConstantRange = ShaderReflection::getPushConstantRange(shaders);
+	if (drawConstantRange.offset != 0 || drawConstantRange.size > sizeof(DrawConstants))
+	{
+		throw std::runtime_error("shaders read push constants outside of DrawConstants!");
+	}
+	pipelineLayout = shaderReflection.getPipelineLayout(setLayouts, drawConstantRange);
+
+	// Vertex input
+	std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+	getVertexInputDescriptions(VertexStreams::All, bindingDescriptions, attributeDescriptions);
+	uint32_t vertexLayout = pipelineLibrary.addVertexLayout(bindingDescriptions, attributeDescriptions);
+	getVertexInputDescriptions(VertexStreams::PositionOnly, bindingDescriptions, attributeDescriptions);
+	uint32_t positionLayout = pipelineLibrary.addVertexLayout(bindingDescriptions, attributeDescriptions);
+
+	PipelineLibrary::Description colorPass;
+	colorPass.vertexShader = getShaderPath(VERTEX_SHADER_SOURCE, VERTEX_SHADER_PATH);
+	colorPass.fragmentShader = virtualTextureEnabled ?
+		getShaderPath(VIRTUAL_TEXTURE_SHADER_SOURCE, VIRTUAL_TEXTURE_SHADER_PATH) : bindlessTexturesSupported ?
+		getShaderPath(BINDLESS_FRAG_SHADER_SOURCE, BINDLESS_FRAG_SHADER_PATH) :
+		getShaderPath(FRAG_SHADER_SOURCE, FRAG_SHADER_PATH);
+	if (!virtualTextureEnabled && !bindlessTexturesSupported)
+	{
+		colorPass.specialization = getShaderSpecialization(DEFAULT_SHADER_FEATURES);
+	}
+	colorPass.vertexLayout = vertexLayout;
+	colorPass.samples = msaaSamples;
+	colorPass.minSampleShading = 0.2f; // min fraction for sample shading; closer to one is smoother
+	colorPass.layout = pipelineLayout;
+	colorPass.renderPass = renderPass;
+
+	// Color pass after the depth prepass: depth is already final, so only the visible samples pass
+	PipelineLibrary::Description depthEqual = colorPass;
+	depthEqual.depthWrite = VK_FALSE;
+	depthEqual.depthCompareOp = VK_COMPARE_OP_EQUAL;
+
+	// Depth prepass: vertex stage only, reading nothing but the position stream.
+	// Without a fragment shader sample shading has nothing to run, and color writes are masked off.
+	PipelineLibrary::Description depthPrepass = colorPass;
+	depthPrepass.vertexShader = getShaderPath(DEPTH_SHADER_SOURCE, DEPTH_SHADER_PATH);
+	depthPrepass.fragmentShader.clear();
+	depthPrepass.specialization.clear();
+	depthPrepass.vertexLayout = positionLayout;
+	depthPrepass.minSampleShading = 0.0f;
+	depthPrepass.colorWriteMask = 0;
+
+	uint32_t created = pipelineLibrary.getStats().created;
+	double time = pipelineLibrary.compile({colorPass, depthEqual, depthPrepass});
+	graphicsPipeline = pipelineLibrary.get(colorPass);
+	depthEqualPipeline = pipelineLibrary.get(depthEqual);
+	depthPrepassPipeline = pipelineLibrary.get(depthPrepass);
+	colorPassDescription = colorPass;
+	depthEqualDescription = depthEqual;
+	depthPrepassDescription = depthPrepass;
+	std::cout << "pipelines: " << pipelineLibrary.getStats().created - created << " created in " << time << " ms on "
+		<< pipelineLibrary.getThreadCount() << " threads" << (pipelineFeatures.extendedDynamicState ? ", dynamic state" : "")
+		<< (pipelineFeatures.extendedDynamicState3 ? ", dynamic blend" : "")
+		<< (pipelineFeatures.graphicsPipelineLibrary ? ", linked from parts" : "") << std::endl;
+}
+
+void HelloTriangleApplication::destroyGraphicsPipeline()
+{
+	// The pipelines belong to the library, the layout to shaderReflection
+}
 
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+void HelloTriangleApplication::startPipelineBurst()
+{
+	// Variants of what the color pass draws with now, every one differs from it in sample shading at least
+	const PipelineLibrary::Description& base = depthPrepassEnabled ? depthEqualDescription : colorPassDescription;
+	pipelineBurst = {};
+	for (uint32_t i = 0; i < PIPELINE_BURST_VARIANTS; i++)
+	{
+		PipelineLibrary::Description variant = base;
+		variant.cullMode = i % 2 == 0 ? VK_CULL_MODE_BACK_BIT : VK_CULL_MODE_NONE;
+		variant.blend = (i / 2) % 2 == 0 ? VK_FALSE : VK_TRUE;
+		variant.colorWriteMask = base.colorWriteMask ^ ((i / 4) % 16);
+		variant.minSampleShading = 0.25f * (1 + (i / 64) % 4);
+		pipelineBurst.variants.push_back(variant);
+	}
+	pipelineBurst.active = true;
+	pipelineBurst.start = std::chrono::high_resolution_clock::now();
 
-	VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
-	vertShaderStageInfo.pName = "main";
+	if (ASYNC_PIPELINES)
+	{
+		for (const PipelineLibrary::Description& variant : pipelineBurst.variants)
+		{
+			pipelineLibrary.request(variant);
+		}
+	}
+	else
+	{
+		pipelineLibrary.compile(pipelineBurst.variants);
+	}
+}
 
-	VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
-	fragShaderStageInfo.pName = "main";
+// description is left alone when the fallback is returned
+VkPipeline HelloTriangleApplication::getBurstPipeline(VkPipeline fallback,
+                                                      const PipelineLibrary::Description*& description)
+{
+	const PipelineLibrary::Description& variant = pipelineBurst.variants[pipelineBurst.frames % pipelineBurst.variants.size()];
+	VkPipeline pipeline = pipelineLibrary.request(variant);
+	if (pipeline != VK_NULL_HANDLE)
+	{
+		description = &variant;
+		return pipeline;
+	}
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+	if (PIPELINE_FALLBACK)
+	{
+		pipelineBurst.fallbackDraws++;
+		return fallback;
+	}
+	pipelineBurst.skippedDraws++;
+	return VK_NULL_HANDLE;
+}
 
-	// Pipeline state
-	// Dynamic state
-	std::vector<VkDynamicState> dynamicStates =
+void HelloTriangleApplication::updatePipelineBurst(double frameTime)
+{
+	pipelineBurst.frames++;
+	pipelineBurst.frameTimeMax = std::max(pipelineBurst.frameTimeMax, frameTime);
+	if (frameTime > FRAME_BUDGET_MS)
 	{
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
+		pipelineBurst.framesOverBudget++;
+	}
 
-	VkPipelineDynamicStateCreateInfo dynamicState{};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-	dynamicState.pDynamicStates = dynamicStates.data();
+	// Done once the last variant is published
+	if (pipelineLibrary.getPendingCount() > 0) return;
+
+	auto now = std::chrono::high_resolution_clock::now();
+	std::cout << "pipeline burst: " << pipelineBurst.variants.size() << " variants "
+		<< (ASYNC_PIPELINES ? "async" : "sync") << ", all ready after "
+		<< std::chrono::duration<double, std::milli>(now - pipelineBurst.start).count() << " ms over "
+		<< pipelineBurst.frames << " frames, " << pipelineBurst.framesOverBudget << " over the " << FRAME_BUDGET_MS
+		<< " ms budget, longest " << pipelineBurst.frameTimeMax << " ms, " << pipelineBurst.fallbackDraws
+		<< " draws with the fallback, " << pipelineBurst.skippedDraws << " skipped" << std::endl;
+	pipelineBurst.active = false;
+}
 
-	VkPipelineViewportStateCreateInfo viewportState{};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.scissorCount = 1;
+void HelloTriangleApplication::benchmarkPipelinePermutations()
+{
+	// Cull mode, front face, depth compare, blending and write mask: everything the dynamic state covers and a
+	// pipeline library splits between parts
+	const std::array<VkCompareOp, 4> compareOps = {VK_COMPARE_OP_LESS, VK_COMPARE_OP_LESS_OR_EQUAL,
+	                                               VK_COMPARE_OP_EQUAL, VK_COMPARE_OP_ALWAYS};
+	const VkColorComponentFlags rgb = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+	std::vector<PipelineLibrary::Description> permutations;
+	for (uint32_t i = 0; i < PIPELINE_PERMUTATIONS; i++)
+	{
+		PipelineLibrary::Description permutation = colorPassDescription;
+		permutation.cullMode = i % 2 == 0 ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
+		permutation.frontFace = (i / 2) % 2 == 0 ? VK_FRONT_FACE_COUNTER_CLOCKWISE : VK_FRONT_FACE_CLOCKWISE;
+		permutation.depthCompareOp = compareOps[(i / 4) % compareOps.size()];
+		permutation.blend = (i / 16) % 2 == 0 ? VK_FALSE : VK_TRUE;
+		permutation.colorWriteMask = (i / 32) % 2 == 0 ? rgb | VK_COLOR_COMPONENT_A_BIT : rgb;
+		permutations.push_back(permutation);
+	}
 
-	// Vertex input
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-	// Input assembly
-	// VK_PRIMITIVE_TOPOLOGY_POINT_LIST: points from vertices
-	// VK_PRIMITIVE_TOPOLOGY_LINE_LIST: line from every 2 vertices without reuse
-	// VK_PRIMITIVE_TOPOLOGY_LINE_STRIP: the end vertex of every line is used as start vertex for the next line
-	// VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST: triangle from every 3 vertices without reuse
-	// VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: the second and third vertex of every triangle are used as first two vertices of the next triangle
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-	// If true, then it's possible to break up lines and triangles in the _STRIP topology modes by using a special index of 0xFFFF or 0xFFFFFFFF
-
-	// Rasterizer
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	// If true, fragments beyond near and far planes are clamped instead of discarded
-	rasterizer.rasterizerDiscardEnable = VK_FALSE; // If true, geometry never passes through rasterizer stage
-	// VK_POLYGON_MODE_FILL: fill the area of the polygon with fragments
-	// VK_POLYGON_MODE_LINE: polygon edges are drawn as lines
-	// VK_POLYGON_MODE_POINT: polygon vertices are drawn as points
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE; // If true, then fragments can be given a constant depth bias value
-	rasterizer.depthBiasConstantFactor = 0.0f; // Optional
-	rasterizer.depthBiasClamp = 0.0f; // Optional
-	rasterizer.depthBiasSlopeFactor = 0.0f; // Optional
-
-	// Multisampling
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_TRUE; // enable sample shading in the pipeline
-	multisampling.rasterizationSamples = msaaSamples;
-	multisampling.minSampleShading = 0.2f; // min fraction for sample shading; closer to one is smoother
-	multisampling.pSampleMask = nullptr; // Optional
-	multisampling.alphaToCoverageEnable = VK_FALSE; // Optional
-	multisampling.alphaToOneEnable = VK_FALSE; // Optional
-
-	// Depth and stencil testing
-	VkPipelineDepthStencilStateCreateInfo depthStencil{};
-	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-	depthStencil.depthBoundsTestEnable = VK_FALSE;
-	depthStencil.minDepthBounds = 0.0f; // Optional
-	depthStencil.maxDepthBounds = 1.0f; // Optional
-	depthStencil.stencilTestEnable = VK_FALSE;
-	depthStencil.front = {}; // Optional
-	depthStencil.back = {}; // Optional
-
-	// Color blending
-	VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT
-		| VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-	// If true, then the new color is calculated using the following formula: finalColor.rgb = newAlpha * newColor + (1 - newAlpha) * oldColor;
-	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD; // Optional
-	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE; // Optional
-	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO; // Optional
-	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD; // Optional
-
-	VkPipelineColorBlendStateCreateInfo colorBlending{};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.logicOp = VK_LOGIC_OP_COPY; // Optional
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
-	colorBlending.blendConstants[0] = 0.0f; // Optional
-	colorBlending.blendConstants[1] = 0.0f; // Optional
-	colorBlending.blendConstants[2] = 0.0f; // Optional
-	colorBlending.blendConstants[3] = 0.0f; // Optional
+	// Separate libraries with empty caches, so neither run reuses the other's or the app's pipelines
+	const std::array<PipelineLibrary::Features, 2> configurations = {PipelineLibrary::Features{}, pipelineFeatures};
+	const std::array<const char*, 2> names = {"monolithic", "device features"};
+	for (size_t i = 0; i < configurations.size(); i++)
+	{
+		PipelineLibrary library;
+		library.create(device, {}, TutUtils::getWorkerCount(), configurations[i],
+		               [this](const std::string& path, const std::vector<std::string>& defines)
+		               {
+			               return shaderCompiler.load(path, defines);
+		               });
+
+		// Registered in the same order as in createGraphicsPipeline, so the descriptions' layout index holds
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+		getVertexInputDescriptions(VertexStreams::All, bindingDescriptions, attributeDescriptions);
+		library.addVertexLayout(bindingDescriptions, attributeDescriptions);
+		getVertexInputDescriptions(VertexStreams::PositionOnly, bindingDescriptions, attributeDescriptions);
+		library.addVertexLayout(bindingDescriptions, attributeDescriptions);
+
+		double time = library.compile(permutations);
+		PipelineLibrary::Stats stats = library.getStats();
+		std::cout << "pipeline permutations, " << names[i] << ": " << permutations.size() << " permutations in "
+			<< library.getPipelineCount() << " pipelines and " << stats.parts << " parts, " << time << " ms on "
+			<< library.getThreadCount() << " threads, " << stats.createTime << " ms creating of which "
+			<< stats.linkTime << " ms linking" << std::endl;
+		library.destroy();
+	}
+}
 
-	// Pipeline layout
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-	pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+// constant_id i of Shader.frag is feature bit i
+std::vector<uint32_t> HelloTriangleApplication::getShaderSpecialization(uint32_t features) const
+{
+	std::vector<uint32_t> specialization(SHADER_FEATURE_COUNT);
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+	{
+		specialization[i] = (features >> i) & 1; // a bool constant is 32 bits, 0 or 1
+	}
+	return specialization;
+}
 
-	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+void HelloTriangleApplication::startVariantBenchmark()
+{
+	// The uber shader only exists as GLSL
+	if (getShaderPath(FRAG_SHADER_SOURCE, FRAG_SHADER_PATH) != FRAG_SHADER_SOURCE)
 	{
-		throw std::runtime_error("failed to create pipeline layout!");
+		std::cout << "shader variant benchmark: needs RUNTIME_SHADERS and shaderc, skipped" << std::endl;
+		return;
+	}
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (!properties.limits.timestampComputeAndGraphics)
+	{
+		std::cout << "shader variant benchmark: no timestamps on the graphics queue, skipped" << std::endl;
+		return;
+	}
+
+	// The color pass as it is, but always with Shader.frag. LESS_OR_EQUAL lets every repeated draw shade the
+	// samples the first one (or the prepass) left visible, so each draw does the same work.
+	const uint32_t configurationCount = (1u << SHADER_FEATURE_COUNT) * 2;
+	variantBenchmark = {};
+	for (uint32_t i = 0; i < configurationCount; i++)
+	{
+		PipelineLibrary::Description description = colorPassDescription;
+		description.fragmentShader = FRAG_SHADER_SOURCE;
+		description.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		if (i % 2 == 0)
+		{
+			description.specialization = getShaderSpecialization(i / 2);
+		}
+		else
+		{
+			description.specialization.clear();
+			description.defines = {"UBER_SHADER"};
+		}
+		variantBenchmark.descriptions.push_back(description);
+	}
+
+	// Compiled up front, so no frame of the benchmark waits for a pipeline
+	uint32_t created = pipelineLibrary.getStats().created;
+	double time = pipelineLibrary.compile(variantBenchmark.descriptions);
+	std::cout << "shader variant benchmark: " << pipelineLibrary.getStats().created - created << " pipelines created in "
+		<< time << " ms" << std::endl;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * 2;
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &variantBenchmark.queryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+	variantBenchmark.timestampPeriod = properties.limits.timestampPeriod;
+	variantBenchmark.gpuTime.assign(configurationCount, 0.0);
+	variantBenchmark.samples.assign(configurationCount, 0);
+	variantBenchmark.queryPending.assign(MAX_FRAMES_IN_FLIGHT, false);
+	variantBenchmark.queryConfiguration.assign(MAX_FRAMES_IN_FLIGHT, 0);
+	variantBenchmark.active = true;
+}
+
+// Inside the render pass, the queries of the frame were reset before it. Only called while a configuration is
+// left to record.
+void HelloTriangleApplication::recordVariantBenchmark(VkCommandBuffer commandBuffer)
+{
+	uint32_t configuration = variantBenchmark.configuration;
+	const PipelineLibrary::Description& description = variantBenchmark.descriptions[configuration];
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLibrary.get(description));
+	pipelineLibrary.setDynamicState(commandBuffer, description);
+
+	// Only the uber shader reads them, the specialized pipelines have them baked in
+	uint32_t features = configuration / 2;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags, offsetof(DrawConstants, features),
+	                   sizeof(uint32_t), &features);
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, variantBenchmark.queryPool, currentFrame * 2);
+	for (uint32_t i = 0; i < SHADER_VARIANT_BENCHMARK_DRAWS; i++)
+	{
+		vkCmdDrawIndexed(commandBuffer, modelDraw.indexCount, 1, modelDraw.firstIndex, modelDraw.vertexOffset, 0);
+	}
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, variantBenchmark.queryPool,
+	                    currentFrame * 2 + 1);
+	variantBenchmark.queryPending[currentFrame] = true;
+	variantBenchmark.queryConfiguration[currentFrame] = configuration;
+
+	if (++variantBenchmark.frames == SHADER_VARIANT_BENCHMARK_FRAMES)
+	{
+		variantBenchmark.frames = 0;
+		variantBenchmark.configuration++;
 	}
+}
 
-	// Create graphics pipeline
-	VkGraphicsPipelineCreateInfo pipelineInfo{};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2; // Shader stages
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = pipelineLayout;
-	pipelineInfo.renderPass = renderPass;
-	pipelineInfo.subpass = 0; // Index of subpass in render pass where pipeline will be used
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
-	pipelineInfo.basePipelineIndex = -1; // Optional
+void HelloTriangleApplication::readVariantTimestamps(uint32_t frame)
+{
+	if (!variantBenchmark.active) return;
 
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+	if (variantBenchmark.queryPending[frame])
 	{
-		throw std::runtime_error("failed to create graphics pipeline!");
+		// Like the statistics, a result that isn't there yet is dropped
+		uint64_t timestamps[2];
+		VkResult result = vkGetQueryPoolResults(device, variantBenchmark.queryPool, frame * 2, 2, sizeof(timestamps),
+		                                        timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		variantBenchmark.queryPending[frame] = false;
+		if (result == VK_SUCCESS)
+		{
+			uint32_t configuration = variantBenchmark.queryConfiguration[frame];
+			variantBenchmark.gpuTime[configuration] +=
+				static_cast<double>(timestamps[1] - timestamps[0]) * variantBenchmark.timestampPeriod / 1e6;
+			variantBenchmark.samples[configuration]++;
+		}
 	}
 
-	// destroy
-	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
+	// Done once every configuration is recorded and its last frame read back
+	if (variantBenchmark.configuration < variantBenchmark.descriptions.size()) return;
+	for (bool pending : variantBenchmark.queryPending)
+	{
+		if (pending) return;
+	}
+	finishVariantBenchmark();
 }
 
-void HelloTriangleApplication::destroyGraphicsPipeline()
+void HelloTriangleApplication::finishVariantBenchmark()
 {
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+	const std::array<const char*, 3> names = {"texture", "vertex color", "alpha test"};
+	std::cout << "shader variant benchmark: " << SHADER_VARIANT_BENCHMARK_DRAWS << " draws a frame, GPU time per "
+		<< "frame averaged over " << SHADER_VARIANT_BENCHMARK_FRAMES << " frames" << std::endl;
+	for (uint32_t features = 0; features < (1u << SHADER_FEATURE_COUNT); features++)
+	{
+		std::string enabled;
+		for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++)
+		{
+			if ((features >> i) & 1)
+			{
+				enabled += enabled.empty() ? names[i] : std::string(" + ") + names[i];
+			}
+		}
+
+		std::array<double, 2> average{};
+		for (uint32_t uber = 0; uber < 2; uber++)
+		{
+			uint32_t configuration = features * 2 + uber;
+			uint32_t samples = variantBenchmark.samples[configuration];
+			average[uber] = samples > 0 ? variantBenchmark.gpuTime[configuration] / samples : 0.0;
+		}
+		std::cout << "  " << (enabled.empty() ? "none" : enabled) << ": specialized " << average[0] << " ms, uber "
+			<< average[1] << " ms";
+		if (average[0] > 0.0)
+		{
+			std::cout << " (" << average[1] / average[0] << "x)";
+		}
+		std::cout << std::endl;
+	}
+
+	// The query pool stays until cleanup, when no frame in flight can still have it in a command buffer
+	variantBenchmark.active = false;
 }
 
 VkShaderModule HelloTriangleApplication::createShaderModule(const std::vector<char>& code)
@@ -830,6 +1457,13 @@ void HelloTriangleApplication::recordCommandBuffer(VkCommandBuffer commandBuffer
 		throw std::runtime_error("failed to begin recording command buffer!");
 	}
 
+	// Pages that finished loading go into the atlas before anything samples it
+	recordVirtualTextureUploads(commandBuffer);
+	// Same for the levels of streamed textures
+	recordTextureStreaming(commandBuffer);
+	// Set 0 with whatever the texture is now
+	descriptorSets[currentFrame] = allocateDescriptorSet(currentFrame);
+
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = renderPass;
@@ -843,10 +1477,24 @@ void HelloTriangleApplication::recordCommandBuffer(VkCommandBuffer commandBuffer
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
 
+	// Queries have to be reset outside of a render pass before they can be begun again
+	if (pipelineStatisticsSupported)
+	{
+		vkCmdResetQueryPool(commandBuffer, statisticsQueryPool, currentFrame, 1);
+		vkCmdBeginQuery(commandBuffer, statisticsQueryPool, currentFrame, 0);
+	}
+	// Once every configuration is recorded the frames draw the model again and leave the timestamps alone,
+	// only the frames still in flight read theirs back
+	bool recordingVariants = variantBenchmark.active &&
+		variantBenchmark.configuration < variantBenchmark.descriptions.size();
+	if (recordingVariants)
+	{
+		vkCmdResetQueryPool(commandBuffer, variantBenchmark.queryPool, currentFrame * 2, 2);
+	}
+
 	// VK_SUBPASS_CONTENTS_INLINE: The render pass commands will be embedded in the primary command buffer itself and no secondary command buffers will be executed.
 	// VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS: The render pass commands will be executed from secondary command buffers.
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
 
 	VkViewport viewport{};
 	viewport.x = 0.0f;
@@ -868,22 +1516,79 @@ void HelloTriangleApplication::recordCommandBuffer(VkCommandBuffer commandBuffer
 	// firstInstance: Used as an offset for instanced rendering, defines the lowest value of gl_InstanceIndex.
 	// vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-	VkBuffer vertexBuffers[] = {vertexBuffer};
-	VkDeviceSize offsets[] = {0};
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, modelDraw.indexType);
+
+	// Uniform buffers(descriptor sets), bindless textures go to set 1 and stay bound whatever the material
+	std::array<VkDescriptorSet, 2> boundSets = {descriptorSets[currentFrame], bindlessTextures.getSet()};
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+	                        bindlessTexturesSupported ? 2 : 1, boundSets.data(), 1, &modelUniformOffset);
+
+	// Push constants stay valid across pipeline binds with the same layout, so the prepass sees them too
+	DrawConstants drawConstants{};
+	drawConstants.model = modelMatrix;
+	drawConstants.material = modelMaterial;
+	drawConstants.features = DEFAULT_SHADER_FEATURES;
+	vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags, 0, drawConstantRange.size,
+	                   &drawConstants);
+
+	// Both streams live in the same buffer, binding 0 reads the positions and binding 1 the other attributes
 	// The vkCmdBindVertexBuffers function is used to bind vertex buffers to bindings
 	// The first two parameters, besides the command buffer, specify the offset and number of bindings we're going to specify vertex buffers for
 	// The last two parameters specify the array of vertex buffers to bind and the byte offsets to start reading vertex data from
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	VkBuffer vertexBuffers[] = {vertexBuffer, vertexBuffer};
+
+	if (depthPrepassEnabled)
+	{
+		// Depth only, the prepass pipeline has a single binding for the position stream
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrepassPipeline);
+		pipelineLibrary.setDynamicState(commandBuffer, depthPrepassDescription);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, vertexStreamOffsets.data());
+		vkCmdDrawIndexed(commandBuffer, modelDraw.indexCount, 1, modelDraw.firstIndex, modelDraw.vertexOffset, 0);
+	}
 
-	// Uniform buffers(descriptor sets)
-	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-	                        &descriptorSets[currentFrame], 0, nullptr);
+	VkPipeline colorPipeline = depthPrepassEnabled ? depthEqualPipeline : graphicsPipeline;
+	const PipelineLibrary::Description* colorDescription = depthPrepassEnabled ? &depthEqualDescription :
+		&colorPassDescription;
+	if (pipelineBurst.active)
+	{
+		colorPipeline = getBurstPipeline(colorPipeline, colorDescription);
+	}
+
+	if (recordingVariants)
+	{
+		// In place of the color pass, with the same vertex streams
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexStreamOffsets.data());
+		recordVariantBenchmark(commandBuffer);
+	}
+	else if (colorPipeline != VK_NULL_HANDLE)
+	{
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, colorPipeline);
+		pipelineLibrary.setDynamicState(commandBuffer, *colorDescription);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexStreamOffsets.data());
 
-	// vkCmdDraw(commandBuffer, vertices.size(), 1, 0, 0);
-	vkCmdDrawIndexed(commandBuffer, indices.size(), 1, 0, 0, 0);
+		// vkCmdDraw(commandBuffer, vertices.size(), 1, 0, 0);
+		vkCmdDrawIndexed(commandBuffer, modelDraw.indexCount, 1, modelDraw.firstIndex, modelDraw.vertexOffset, 0);
+	}
 
 	vkCmdEndRenderPass(commandBuffer);
+
+	// The feedback is read on the host once the frame's fence signalled
+	if (virtualTextureEnabled)
+	{
+		VkMemoryBarrier feedbackBarrier{};
+		feedbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		feedbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		feedbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+		                     &feedbackBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	if (pipelineStatisticsSupported)
+	{
+		vkCmdEndQuery(commandBuffer, statisticsQueryPool, currentFrame);
+		statisticsQueryPending[currentFrame] = true;
+	}
+
 	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
 	{
 		throw std::runtime_error("failed to record command buffer!");
@@ -895,6 +1600,23 @@ void HelloTriangleApplication::drawFrame()
 	// 1. Waiting for the previous frame
 	vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
+	// The fence covers the query of the frame that last used this slot, collect it before it is reset
+	readPipelineStatistics(currentFrame);
+	readVariantTimestamps(currentFrame);
+	readVirtualTextureFeedback(currentFrame);
+	releaseRetiredTextures(currentFrame);
+	frameDescriptorAllocators[currentFrame].reset();
+
+	// Shaders saved since the last frame, pipelines finished since then, then the burst starts inside the frame it
+	// stalls
+	reloadChangedShaders();
+	pipelineLibrary.publish();
+	if (pipelineBurstRequested && !pipelineBurst.active)
+	{
+		startPipelineBurst();
+	}
+	pipelineBurstRequested = false;
+
 	// 2. Acquiring an image from the swap chain
 	// The index refers to the VkImage in our swapChainImages array. We're going to use that index to pick the VkFrameBuffer
 	uint32_t imageIndex;
@@ -974,13 +1696,163 @@ void HelloTriangleApplication::drawFrame()
 	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void HelloTriangleApplication::createSyncObjects()
+void HelloTriangleApplication::updateFrameStats()
 {
-	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	auto now = std::chrono::high_resolution_clock::now();
+	double frameTime = std::chrono::duration<double, std::chrono::milliseconds::period>(now - frameStats.lastFrame).count();
+	frameStats.lastFrame = now;
+
+	frameStats.frameCount++;
+	frameStats.frameTimeSum += frameTime;
+	frameStats.frameTimeMax = std::max(frameStats.frameTimeMax, frameTime);
+	if (pipelineBurst.active)
+	{
+		updatePipelineBurst(frameTime);
+	}
 
-	VkSemaphoreCreateInfo semaphoreInfo{};
+	if (now - frameStats.lastReport >= std::chrono::seconds(1))
+	{
+		reportFrameStats();
+		frameStats.frameCount = 0;
+		frameStats.frameTimeSum = 0.0;
+		frameStats.frameTimeMax = 0.0;
+		frameStats.statisticsCount = 0;
+		frameStats.statisticsSum = {};
+		frameStats.lastReport = now;
+	}
+}
+
+void HelloTriangleApplication::reportFrameStats()
+{
+	if (frameStats.frameCount == 0) return;
+
+	double avgFrameTime = frameStats.frameTimeSum / frameStats.frameCount;
+	std::cout << "frame: " << avgFrameTime << " ms avg, " << frameStats.frameTimeMax << " ms max, "
+		<< 1000.0 / avgFrameTime << " fps"
+		<< " | depth prepass " << (depthPrepassEnabled ? "on" : "off")
+		<< " | vertices: " << (vertexFormat == VertexFormat::Compact ? "compact " : "full ")
+		<< getVertexBufferSize() << " bytes"
+		<< " | indices: " << (modelDraw.indexType == VK_INDEX_TYPE_UINT16 ? "uint16 " : "uint32 ")
+		<< indexBufferSize << " bytes";
+
+	// Sets per frame since the last report, pools of every frame in flight
+	DescriptorAllocator::Stats descriptorStats;
+	for (const auto& allocator : frameDescriptorAllocators)
+	{
+		const DescriptorAllocator::Stats& stats = allocator.getStats();
+		descriptorStats.allocations += stats.allocations;
+		descriptorStats.pools += stats.pools;
+		descriptorStats.setCapacity += stats.setCapacity;
+		descriptorStats.descriptorCapacity += stats.descriptorCapacity;
+	}
+	std::cout << " | descriptors: "
+		<< static_cast<double>(descriptorStats.allocations - frameStats.descriptorAllocations) / frameStats.frameCount
+		<< " sets/frame, " << descriptorStats.pools << " pools of " << descriptorStats.setCapacity << " sets, "
+		<< descriptorStats.descriptorCapacity << " descriptors, " << descriptorLayoutCache.getLayoutCount()
+		<< " layouts";
+	frameStats.descriptorAllocations = descriptorStats.allocations;
+
+	PipelineLibrary::Stats pipelineStats = pipelineLibrary.getStats();
+	std::cout << " | pipelines: " << pipelineLibrary.getPipelineCount() << ", " << pipelineStats.created
+		<< " created in " << pipelineStats.createTime << " ms, " << pipelineStats.parts << " parts";
+
+	if (frameStats.statisticsCount > 0)
+	{
+		// per frame averages
+		const PipelineStatistics& sum = frameStats.statisticsSum;
+		uint64_t count = frameStats.statisticsCount;
+		std::cout << " | gpu: " << sum.inputAssemblyVertices / count << " ia vertices, "
+			<< sum.inputAssemblyPrimitives / count << " ia primitives, "
+			<< sum.vertexShaderInvocations / count << " vs invocations, "
+			<< sum.clippingInvocations / count << " -> " << sum.clippingPrimitives / count << " clipped primitives, "
+			<< sum.fragmentShaderInvocations / count << " fs invocations";
+	}
+
+	if (virtualTextureEnabled)
+	{
+		// since the last report
+		const VirtualTexture::Stats& stats = virtualTexture.getStats();
+		const VirtualTexture::Stats& last = frameStats.virtualTextureStats;
+		uint64_t requests = stats.requests - last.requests;
+		uint64_t misses = stats.misses - last.misses;
+		VkDeviceSize residentSize = virtualTexture.getResidentCount() * VirtualTexture::TILE_BYTES;
+		std::cout << " | virtual texture: " << virtualTexture.getResidentCount() << " pages resident, "
+			<< residentSize / 1024 << " KB of " << virtualTexture.getFullSize() / 1024 << " KB, "
+			<< (requests > 0 ? 100.0 * misses / requests : 0.0) << "% page misses, "
+			<< stats.uploads - last.uploads << " uploads, " << stats.evictions - last.evictions << " evictions";
+		frameStats.virtualTextureStats = stats;
+	}
+
+	if (TEXTURE_STREAMING)
+	{
+		// levels since the last report
+		const TextureStreamer::Stats& stats = textureStreamer.getStats();
+		const TextureStreamer::Stats& last = frameStats.textureStreamingStats;
+		std::cout << " | texture streaming: level " << textureStreamer.getFirstLevel(streamedTexture) << " resident, "
+			<< textureStreamer.getWantedLevel(streamedTexture) << " wanted, "
+			<< textureStreamer.getResidentSize() / 1024 << " KB of " << textureStreamer.getFullSize() / 1024
+			<< " KB, budget " << textureStreamer.getBudget() / 1024 << " KB, "
+			<< stats.streamedLevels - last.streamedLevels << " levels in ("
+			<< (stats.uploadedBytes - last.uploadedBytes) / 1024 << " KB), "
+			<< stats.evictedLevels - last.evictedLevels << " evicted";
+		frameStats.textureStreamingStats = stats;
+	}
+	std::cout << std::endl;
+}
+
+void HelloTriangleApplication::createStatisticsQueryPool()
+{
+	if (!pipelineStatisticsSupported) return;
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	queryPoolInfo.queryCount = MAX_FRAMES_IN_FLIGHT;
+	queryPoolInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+	if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &statisticsQueryPool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline statistics query pool!");
+	}
+	statisticsQueryPending.assign(MAX_FRAMES_IN_FLIGHT, false);
+}
+
+void HelloTriangleApplication::destroyStatisticsQueryPool()
+{
+	if (statisticsQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, statisticsQueryPool, nullptr);
+	}
+}
+
+void HelloTriangleApplication::readPipelineStatistics(uint32_t frame)
+{
+	if (!pipelineStatisticsSupported || !statisticsQueryPending[frame]) return;
+
+	// No VK_QUERY_RESULT_WAIT_BIT: if the result is somehow not there yet, drop it rather than stall
+	PipelineStatistics statistics;
+	VkResult result = vkGetQueryPoolResults(device, statisticsQueryPool, frame, 1, sizeof(statistics), &statistics,
+	                                        sizeof(statistics), VK_QUERY_RESULT_64_BIT);
+	statisticsQueryPending[frame] = false;
+	if (result != VK_SUCCESS) return;
+
+	PipelineStatistics& sum = frameStats.statisticsSum;
+	sum.inputAssemblyVertices += statistics.inputAssemblyVertices;
+	sum.inputAssemblyPrimitives += statistics.inputAssemblyPrimitives;
+	sum.vertexShaderInvocations += statistics.vertexShaderInvocations;
+	sum.clippingInvocations += statistics.clippingInvocations;
+	sum.clippingPrimitives += statistics.clippingPrimitives;
+	sum.fragmentShaderInvocations += statistics.fragmentShaderInvocations;
+	frameStats.statisticsCount++;
+}
+
+void HelloTriangleApplication::createSyncObjects()
+{
+	imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+	inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
 	VkFenceCreateInfo fenceInfo{};
@@ -1036,9 +1908,73 @@ void HelloTriangleApplication::cleanupSwapChain()
 	destroySwapChain();
 }
 
+VkDeviceSize HelloTriangleApplication::getPositionStride()
+{
+	return vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex::Position) : sizeof(glm::vec3);
+}
+
+VkDeviceSize HelloTriangleApplication::getAttributeStride()
+{
+	return vertexFormat == VertexFormat::Compact ? sizeof(CompactVertex::Attributes) : sizeof(Vertex::Attributes);
+}
+
+VkDeviceSize HelloTriangleApplication::getVertexBufferSize()
+{
+	return vertexStreamOffsets[1] + getAttributeStride() * vertices.size();
+}
+
+void HelloTriangleApplication::getVertexInputDescriptions(VertexStreams streams,
+                                                          std::vector<VkVertexInputBindingDescription>&
+                                                          bindingDescriptions,
+                                                          std::vector<VkVertexInputAttributeDescription>&
+                                                          attributeDescriptions)
+{
+	// Depth.vert reads nothing but the position
+	const ShaderReflection::Module& shader = streams == VertexStreams::All ?
+		reflectShader(getShaderPath(VERTEX_SHADER_SOURCE, VERTEX_SHADER_PATH)) :
+		reflectShader(getShaderPath(DEPTH_SHADER_SOURCE, DEPTH_SHADER_PATH));
+
+	if (vertexFormat == VertexFormat::Compact)
+	{
+		// Quantized formats are the app's choice, the shader sees floats either way. It only has to read nothing
+		// the vertex doesn't have.
+		bindingDescriptions = CompactVertex::getBindingDescriptions(streams);
+		attributeDescriptions = CompactVertex::getAttributeDescriptions(streams, compactTexCoordFormat);
+		for (const ShaderReflection::Input& input : shader.inputs)
+		{
+			if (std::none_of(attributeDescriptions.begin(), attributeDescriptions.end(),
+			                 [&input](const VkVertexInputAttributeDescription& attribute)
+			                 {
+				                 return attribute.location == input.location;
+			                 }))
+			{
+				throw std::runtime_error("vertex shader reads an attribute the vertex doesn't have!");
+			}
+		}
+		return;
+	}
+
+	// Binding 0 is the position stream, everything after it comes from the attribute stream
+	ShaderReflection::getVertexInput(shader, [](uint32_t location) { return location == 0 ? 0u : 1u; },
+	                                 bindingDescriptions, attributeDescriptions);
+	for (const VkVertexInputBindingDescription& binding : bindingDescriptions)
+	{
+		if (binding.stride != (binding.binding == 0 ? getPositionStride() : getAttributeStride()))
+		{
+			throw std::runtime_error("vertex shader inputs don't match the vertex streams!");
+		}
+	}
+}
+
 void HelloTriangleApplication::createVertexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	// Split the vertices into a position stream and an attribute stream.
+	// The attribute stream starts 16 byte aligned, which covers the alignment of every vertex format used here.
+	VkDeviceSize positionStride = getPositionStride();
+	VkDeviceSize attributeStride = getAttributeStride();
+	vertexStreamOffsets[0] = 0;
+	vertexStreamOffsets[1] = (positionStride * vertices.size() + 15) & ~VkDeviceSize(15);
+	VkDeviceSize bufferSize = getVertexBufferSize();
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
@@ -1051,7 +1987,22 @@ void HelloTriangleApplication::createVertexBuffer()
 	// The second to last parameter can be used to specify flags,
 	// but there aren't any available yet in the current API. It must be set to the value 0
 	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, vertices.data(), bufferSize);
+	char* positionData = static_cast<char*>(data) + vertexStreamOffsets[0];
+	char* attributeData = static_cast<char*>(data) + vertexStreamOffsets[1];
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (vertexFormat == VertexFormat::Compact)
+		{
+			memcpy(positionData + i * positionStride, &compactVertices[i].position, positionStride);
+			memcpy(attributeData + i * attributeStride, &compactVertices[i].attributes, attributeStride);
+		}
+		else
+		{
+			Vertex::Attributes attributes{vertices[i].color, vertices[i].texCoord};
+			memcpy(positionData + i * positionStride, &vertices[i].pos, positionStride);
+			memcpy(attributeData + i * attributeStride, &attributes, attributeStride);
+		}
+	}
 	vkUnmapMemory(device, stagingBufferMemory);
 
 	// VK_BUFFER_USAGE_TRANSFER_SRC_BIT: Buffer can be used as source in a memory transfer operation.
@@ -1063,6 +2014,13 @@ void HelloTriangleApplication::createVertexBuffer()
 
 	vkDestroyBuffer(device, stagingBuffer, nullptr);
 	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	// Bytes fetched per vertex by a pass that only reads positions vs. one that reads everything
+	VkDeviceSize fullFetch = positionStride + attributeStride;
+	std::cout << "vertex streams: position " << positionStride << " B/vertex, attributes " << attributeStride
+		<< " B/vertex, position-only passes fetch " << positionStride << " of " << fullFetch << " B/vertex ("
+		<< 100.0 * (1.0 - static_cast<double>(positionStride) / fullFetch) << "% less, "
+		<< (fullFetch - positionStride) * vertices.size() << " bytes saved per draw)" << std::endl;
 }
 
 void HelloTriangleApplication::destroyVertexBuffer()
@@ -1073,7 +2031,16 @@ void HelloTriangleApplication::destroyVertexBuffer()
 
 void HelloTriangleApplication::createIndexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+	// 16 bit indices halve the index buffer whenever the mesh has few enough vertices.
+	// 0xFFFF is kept free, it is the primitive restart index for VK_INDEX_TYPE_UINT16.
+	modelDraw.indexCount = static_cast<uint32_t>(indices.size());
+	modelDraw.firstIndex = 0;
+	modelDraw.vertexOffset = 0;
+	modelDraw.indexType = vertices.size() < 0xFFFF ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+
+	size_t indexSize = modelDraw.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	VkDeviceSize bufferSize = indexSize * indices.size();
+	indexBufferSize = bufferSize;
 
 	VkBuffer stagingBuffer;
 	VkDeviceMemory stagingBufferMemory;
@@ -1083,7 +2050,19 @@ void HelloTriangleApplication::createIndexBuffer()
 
 	void* data;
 	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), bufferSize);
+	if (modelDraw.indexType == VK_INDEX_TYPE_UINT16)
+	{
+		// narrow straight into the mapped staging memory
+		uint16_t* indices16 = static_cast<uint16_t*>(data);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			indices16[i] = static_cast<uint16_t>(indices[i]);
+		}
+	}
+	else
+	{
+		memcpy(data, indices.data(), bufferSize);
+	}
 	vkUnmapMemory(device, stagingBufferMemory);
 
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
@@ -1103,41 +2082,55 @@ void HelloTriangleApplication::destroyIndexBuffer()
 
 void HelloTriangleApplication::createDescriptorSetLayout()
 {
-	VkDescriptorSetLayoutBinding uboLayoutBinding{};
-	uboLayoutBinding.binding = 0;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	uboLayoutBinding.descriptorCount = 1; // Number of values in the array
-	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT; // The shader stage that will access this binding
-	uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+	// Binding 0: the uniform buffer (vertex stage)
+	// Binding 1: the texture (fragment stage)
+	// With the virtual texture also the page table, page atlas and feedback buffer (fragment stage)
+	std::vector<VkDescriptorSetLayoutBinding> bindings =
+		ShaderReflection::getSetBindings(getPipelineLayoutShaders(), 0);
+
+	// getSetDescriptors() fills them in binding order
+	uint32_t bindingCount = virtualTextureEnabled ? 5 : 2;
+	if (bindings.size() != bindingCount)
+	{
+		throw std::runtime_error("shaders don't declare the bindings of set 0 the app writes!");
+	}
+	for (uint32_t i = 0; i < bindingCount; i++)
+	{
+		if (bindings[i].binding != i)
+		{
+			throw std::runtime_error("shaders don't declare the bindings of set 0 the app writes!");
+		}
+	}
 
-	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
-	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorCount = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	samplerLayoutBinding.pImmutableSamplers = nullptr;
-	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	// Dynamic: the offset into the frame's uniform buffer is given when the set is bound, per draw
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {uboLayoutBinding, samplerLayoutBinding};
+	// Virtual texture: the samplers of the page table and the page atlas never change, baked into the layout the
+	// descriptor writes leave them out
+	if (virtualTextureEnabled)
+	{
+		createVirtualTextureSamplers();
+		bindings[2].pImmutableSamplers = &pageTableSampler;
+		bindings[3].pImmutableSamplers = &pageAtlasSampler;
+	}
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 	layoutInfo.pBindings = bindings.data();
 
-	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to create descriptor set layout!");
-	}
-}
-
-void HelloTriangleApplication::destroyDescriptorSetLayout()
-{
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+	descriptorSetLayout = descriptorLayoutCache.get(layoutInfo);
+	descriptorSetBindings = bindings;
+	descriptorWriter.create(device, bindings, descriptorSetLayout);
 }
 
 void HelloTriangleApplication::createUniformBuffers()
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+	VkDeviceSize bufferSize = UNIFORM_RING_SIZE;
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	uniformBufferAlignment = properties.limits.minUniformBufferOffsetAlignment;
 
 	uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 	uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
@@ -1170,190 +2163,1319 @@ void HelloTriangleApplication::updateUniformBuffer(uint32_t currentImage)
 	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
 	UniformBufferObject ubo{};
-	ubo.model = rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 rotation = rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+	modelMatrix = rotation * vertexDequantize; // pushed with the draw
 	// eye, center, up positions respectively
 	ubo.view = lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / static_cast<float>(swapChainExtent.height),
 	                            0.1f, 10.0f);
 	ubo.proj[1][1] *= -1; // Invert Y coordinate
 
-	memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	// The frame's fence was waited on, so the whole buffer is free again
+	uniformAllocator.reset(uniformBuffersMapped[currentImage], UNIFORM_RING_SIZE, uniformBufferAlignment);
+	modelUniformOffset = uniformAllocator.push(ubo);
+
+	// Pixels the bounding sphere's diameter spans on screen, what the texture streamer sizes the model's texture by
+	glm::vec4 center = ubo.view * rotation * glm::vec4(glm::vec3(modelBoundingSphere), 1.0f);
+	float distance = std::max(-center.z - modelBoundingSphere.w, 0.1f);
+	modelScreenSize = modelBoundingSphere.w * std::abs(ubo.proj[1][1]) / distance * swapChainExtent.height;
 }
 
-void HelloTriangleApplication::createDescriptorPool()
+void HelloTriangleApplication::benchmarkUniforms()
 {
+	// Every object gets its own model matrix each frame, written and bound both ways.
+	// Nothing is drawn or submitted, only the CPU side is timed.
+	const uint32_t objectCount = UNIFORM_BENCHMARK_OBJECTS;
+	const int frames = 100;
+
+	std::vector<glm::mat4> objects(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		objects[i] = translate(glm::mat4(1.0f), glm::vec3(static_cast<float>(i % 100), i / 100.0f, 0.0f));
+	}
+
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	VkDeviceSize alignedSize = (sizeof(glm::mat4) + uniformBufferAlignment - 1) & ~(uniformBufferAlignment - 1);
+
+	// Separate buffers: a buffer and a descriptor set per object. They share one allocation, 10k allocations of their
+	// own would be over maxMemoryAllocationCount (4096 on a lot of drivers).
+	auto separateStart = std::chrono::high_resolution_clock::now();
+	std::vector<VkBuffer> objectBuffers(objectCount);
+	VkMemoryRequirements memRequirements{};
+	for (VkBuffer& buffer : objectBuffers)
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = sizeof(glm::mat4);
+		bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create buffer!");
+		}
+	}
+	vkGetBufferMemoryRequirements(device, objectBuffers[0], &memRequirements);
+	VkDeviceSize objectStride = (memRequirements.size + memRequirements.alignment - 1) & ~(memRequirements.alignment - 1);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = objectStride * objectCount;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, hostVisible);
+
+	VkDeviceMemory objectMemory;
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &objectMemory) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate buffer memory!");
+	}
+	void* objectMapped;
+	vkMapMemory(device, objectMemory, 0, allocInfo.allocationSize, 0, &objectMapped);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		vkBindBufferMemory(device, objectBuffers[i], objectMemory, objectStride * i);
+	}
+
+	// Both ways get a set layout with only the uniform buffer, so the sets bind without a pipeline
+	auto createLayouts = [&](VkDescriptorType type, VkDescriptorSetLayout& setLayout, VkPipelineLayout& layout)
+	{
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = 0;
+		binding.descriptorType = type;
+		binding.descriptorCount = 1;
+		binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+		setLayout = descriptorLayoutCache.get(layoutInfo);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+	};
+	VkDescriptorSetLayout separateSetLayout;
+	VkPipelineLayout separateLayout;
+	createLayouts(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, separateSetLayout, separateLayout);
+
 	std::array<VkDescriptorPoolSize, 2> poolSizes{};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[0].descriptorCount = objectCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 1;
 
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolInfo.maxSets = objectCount + 1;
 
-	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+	VkDescriptorPool objectPool;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &objectPool) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to create descriptor pool!");
+		throw std::runtime_error("failed to create object descriptor pool!");
 	}
-}
 
-void HelloTriangleApplication::createDescriptorSets()
-{
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
-	VkDescriptorSetAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	allocInfo.pSetLayouts = layouts.data();
+	std::vector<VkDescriptorSetLayout> layouts(objectCount, separateSetLayout);
+	VkDescriptorSetAllocateInfo setAllocInfo{};
+	setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	setAllocInfo.descriptorPool = objectPool;
+	setAllocInfo.descriptorSetCount = objectCount;
+	setAllocInfo.pSetLayouts = layouts.data();
 
-	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
-	if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS)
+	std::vector<VkDescriptorSet> objectSets(objectCount);
+	if (vkAllocateDescriptorSets(device, &setAllocInfo, objectSets.data()) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to allocate descriptor sets!");
+		throw std::runtime_error("failed to allocate object descriptor sets!");
 	}
-
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	for (uint32_t i = 0; i < objectCount; i++)
 	{
 		VkDescriptorBufferInfo bufferInfo{};
-		bufferInfo.buffer = uniformBuffers[i];
+		bufferInfo.buffer = objectBuffers[i];
 		bufferInfo.offset = 0;
-		bufferInfo.range = sizeof(UniformBufferObject);
+		bufferInfo.range = sizeof(glm::mat4);
+
+		VkWriteDescriptorSet descriptorWrite{};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.dstSet = objectSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+	}
+	auto separateEnd = std::chrono::high_resolution_clock::now();
+
+	// Ring: one buffer and one set, the objects are told apart by their dynamic offsets
+	auto ringStart = std::chrono::high_resolution_clock::now();
+	VkBuffer ringBuffer;
+	VkDeviceMemory ringBufferMemory;
+	VkDeviceSize ringSize = alignedSize * objectCount;
+	createBuffer(ringSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, ringBuffer, ringBufferMemory);
+	void* ringMapped;
+	vkMapMemory(device, ringBufferMemory, 0, ringSize, 0, &ringMapped);
+
+	VkDescriptorSetLayout ringSetLayout;
+	VkPipelineLayout ringLayout;
+	createLayouts(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ringSetLayout, ringLayout);
+
+	setAllocInfo.descriptorSetCount = 1;
+	setAllocInfo.pSetLayouts = &ringSetLayout;
+	VkDescriptorSet ringSet;
+	if (vkAllocateDescriptorSets(device, &setAllocInfo, &ringSet) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate object descriptor sets!");
+	}
 
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = textureImageView;
-		imageInfo.sampler = textureSampler;
+	VkDescriptorBufferInfo ringInfo{};
+	ringInfo.buffer = ringBuffer;
+	ringInfo.offset = 0;
+	ringInfo.range = sizeof(glm::mat4);
+
+	VkWriteDescriptorSet ringWrite{};
+	ringWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	ringWrite.dstSet = ringSet;
+	ringWrite.dstBinding = 0;
+	ringWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	ringWrite.descriptorCount = 1;
+	ringWrite.pBufferInfo = &ringInfo;
+	vkUpdateDescriptorSets(device, 1, &ringWrite, 0, nullptr);
+	auto ringEnd = std::chrono::high_resolution_clock::now();
+
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
 
-		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[0].dstSet = descriptorSets[i];
-		descriptorWrites[0].dstBinding = 0;
-		descriptorWrites[0].dstArrayElement = 0;
-		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		descriptorWrites[0].descriptorCount = 1;
-		descriptorWrites[0].pBufferInfo = &bufferInfo;
+	// Writes and binds every object's uniforms, returns the average time per frame in ms
+	auto run = [&](bool ring)
+	{
+		UniformAllocator allocator;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < frames; frame++)
+		{
+			vkResetCommandBuffer(commandBuffer, 0);
 
-		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrites[1].dstSet = descriptorSets[i];
-		descriptorWrites[1].dstBinding = 1;
-		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrites[1].descriptorCount = 1;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to begin recording command buffer!");
+			}
+
+			allocator.reset(ringMapped, ringSize, uniformBufferAlignment);
+			for (uint32_t i = 0; i < objectCount; i++)
+			{
+				if (ring)
+				{
+					uint32_t dynamicOffset = allocator.push(objects[i]);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, ringLayout, 0, 1, &ringSet,
+					                        1, &dynamicOffset);
+				}
+				else
+				{
+					memcpy(static_cast<char*>(objectMapped) + objectStride * i, &objects[i], sizeof(glm::mat4));
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, separateLayout, 0, 1,
+					                        &objectSets[i], 0, nullptr);
+				}
+			}
+
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to record command buffer!");
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / frames;
+	};
+
+	double separateTime = run(false);
+	double ringTime = run(true);
+	std::cout << "uniform benchmark: " << objectCount << " objects, average of " << frames << " frames" << std::endl;
+	std::cout << "  buffer per object: " << separateTime << " ms per frame, "
+		<< std::chrono::duration<double, std::milli>(separateEnd - separateStart).count() << " ms to create "
+		<< objectCount << " buffers and descriptor sets" << std::endl;
+	std::cout << "  dynamic offsets: " << ringTime << " ms per frame, "
+		<< std::chrono::duration<double, std::milli>(ringEnd - ringStart).count() << " ms to create the buffer, "
+		<< ringSize / 1024 << " KB at " << alignedSize << " bytes per object" << std::endl;
 
-		// It accepts two kinds of arrays as parameters: an array of VkWriteDescriptorSet and an array of VkCopyDescriptorSet.
-		// The latter can be used to copy descriptors to each other, as its name implies
-		vkUpdateDescriptorSets(device, descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	vkDestroyDescriptorPool(device, objectPool, nullptr);
+	vkDestroyPipelineLayout(device, ringLayout, nullptr);
+	vkDestroyPipelineLayout(device, separateLayout, nullptr);
+	vkDestroyBuffer(device, ringBuffer, nullptr);
+	vkFreeMemory(device, ringBufferMemory, nullptr);
+	for (VkBuffer buffer : objectBuffers)
+	{
+		vkDestroyBuffer(device, buffer, nullptr);
 	}
+	vkFreeMemory(device, objectMemory, nullptr);
 }
 
-void HelloTriangleApplication::destroyDescriptorPool()
+void HelloTriangleApplication::benchmarkPushConstants()
 {
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-}
+	// Every draw has a model matrix of its own, handed over either as push constants or written to the frame's
+	// uniform buffer and bound by dynamic offset. Only recording is timed, the command buffer is never submitted,
+	// so the ring may wrap around within a recording and the shader reading the pushed model both times is fine.
+	const uint32_t drawCount = PUSH_CONSTANT_BENCHMARK_DRAWS;
+	const int recordings = 100;
+
+	std::vector<glm::mat4> models(drawCount);
+	for (uint32_t i = 0; i < drawCount; i++)
+	{
+		models[i] = translate(modelMatrix, glm::vec3(static_cast<float>(i % 100), i / 100.0f, 0.0f));
+	}
 
-void HelloTriangleApplication::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
-                                           VkFormat format, VkImageTiling tiling,
-                                           VkImageUsageFlags usage,
-                                           VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
-{
-	// One dimensional images can be used to store an array of data or gradient,
-	// two dimensional images are mainly used for textures,
-	// and three dimensional images can be used to store voxel volumes, for example.
-	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = width;
-	imageInfo.extent.height = height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = mipLevels;
-	imageInfo.arrayLayers = 1;
-	imageInfo.format = format; // format of texels
-	// VK_IMAGE_TILING_LINEAR: Texels are laid out in row-major order like our pixels array
-	// VK_IMAGE_TILING_OPTIMAL: Texels are laid out in an implementation defined order for optimal access
-	imageInfo.tiling = tiling; // layout of pixels
-	// VK_IMAGE_LAYOUT_UNDEFINED: Not usable by the GPU and the very first transition will discard the texels.
-	// VK_IMAGE_LAYOUT_PREINITIALIZED: Not usable by the GPU, but the first transition will preserve the texels.
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = usage;
-	imageInfo.samples = numSamples;
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
 
-	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS)
 	{
-		throw std::runtime_error("failed to create image!");
+		throw std::runtime_error("failed to allocate command buffers!");
 	}
 
-	// allocate memory for image
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device, image, &memRequirements);
+	// Records one draw per model, returns the average time per recording in ms
+	auto record = [&](bool push)
+	{
+		UniformAllocator allocator;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < recordings; i++)
+		{
+			vkResetCommandBuffer(commandBuffer, 0);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to begin recording command buffer!");
+			}
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+			std::array<VkClearValue, 2> clearValues{};
+			clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+			clearValues[1].depthStencil = {1.0f, 0};
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = renderPass;
+			renderPassInfo.framebuffer = swapChainFramebuffers[0];
+			renderPassInfo.renderArea.extent = swapChainExtent;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport{0.0f, 0.0f, static_cast<float>(swapChainExtent.width),
+			                    static_cast<float>(swapChainExtent.height), 0.0f, 1.0f};
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor{{0, 0}, swapChainExtent};
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			VkBuffer vertexBuffers[] = {vertexBuffer, vertexBuffer};
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+			pipelineLibrary.setDynamicState(commandBuffer, colorPassDescription);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexStreamOffsets.data());
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, modelDraw.indexType);
+
+			std::array<VkDescriptorSet, 2> sets = {descriptorSets[0], bindlessTextures.getSet()};
+			const uint32_t frameOffset = 0;
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0,
+			                        bindlessTexturesSupported ? 2 : 1, sets.data(), 1, &frameOffset);
+
+			DrawConstants drawConstants{};
+			drawConstants.material = modelMaterial;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags, 0, drawConstantRange.size,
+			                   &drawConstants);
+
+			allocator.reset(uniformBuffersMapped[0], UNIFORM_RING_SIZE, uniformBufferAlignment);
+			for (uint32_t d = 0; d < drawCount; d++)
+			{
+				if (push)
+				{
+					vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags, 0, sizeof(glm::mat4),
+					                   &models[d]);
+				}
+				else
+				{
+					if (allocator.getUsed() + uniformBufferAlignment + sizeof(glm::mat4) > allocator.getSize())
+					{
+						allocator.reset(uniformBuffersMapped[0], UNIFORM_RING_SIZE, uniformBufferAlignment);
+					}
+					uint32_t dynamicOffset = allocator.push(models[d]);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+					                        &descriptorSets[0], 1, &dynamicOffset);
+				}
+				vkCmdDrawIndexed(commandBuffer, modelDraw.indexCount, 1, modelDraw.firstIndex, modelDraw.vertexOffset, 0);
+			}
 
-	vkBindImageMemory(device, image, imageMemory, 0);
+			vkCmdEndRenderPass(commandBuffer);
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to record command buffer!");
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / recordings;
+	};
+
+	double uniformTime = record(false);
+	double pushTime = record(true);
+	std::cout << "push constant benchmark: " << drawCount << " draws, average of " << recordings << " recordings"
+		<< std::endl;
+	std::cout << "  uniform buffer + dynamic offset: " << uniformTime << " ms to record, "
+		<< uniformTime * 1e6 / drawCount << " ns per draw" << std::endl;
+	std::cout << "  push constants: " << pushTime << " ms to record, " << pushTime * 1e6 / drawCount
+		<< " ns per draw" << std::endl;
+
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 }
 
-void HelloTriangleApplication::createTextureImage()
+void HelloTriangleApplication::benchmarkDescriptorUpdates()
 {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-	if (!pixels)
+	// The same sets are written over and over with what set 0 holds, with a VkWriteDescriptorSet per binding and
+	// with the update template reading the packed array. They come from the first frame's allocator, its first reset
+	// in drawFrame() frees them. Push descriptors are only recorded, the command buffer is never submitted.
+	const uint32_t setCount = DESCRIPTOR_UPDATE_BENCHMARK_SETS;
+	const int rounds = 10;
+
+	std::vector<VkDescriptorSet> sets(setCount);
+	for (VkDescriptorSet& set : sets)
 	{
-		throw std::runtime_error("failed to load texture image!");
+		set = frameDescriptorAllocators[0].allocate(descriptorSetLayout);
 	}
+	std::array<DescriptorWriter::Descriptor, 5> descriptors = getSetDescriptors(0);
 
-	// host visible memory
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-	             stagingBufferMemory);
+	auto updatesPerSecond = [&](std::chrono::high_resolution_clock::time_point start)
+	{
+		auto end = std::chrono::high_resolution_clock::now();
+		return setCount * rounds / std::chrono::duration<double>(end - start).count();
+	};
 
-	// copy pixel values to buffer
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, imageSize);
-	vkUnmapMemory(device, stagingBufferMemory);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (VkDescriptorSet set : sets)
+		{
+			std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+			uint32_t writeCount = 0;
+			for (const VkDescriptorSetLayoutBinding& binding : descriptorSetBindings)
+			{
+				VkWriteDescriptorSet& write = descriptorWrites[writeCount];
+				write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+				write.dstSet = set;
+				write.dstBinding = binding.binding;
+				write.dstArrayElement = 0;
+				write.descriptorType = binding.descriptorType;
+				write.descriptorCount = 1;
+				if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC ||
+					binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+				{
+					write.pBufferInfo = &descriptors[writeCount].buffer;
+				}
+				else
+				{
+					write.pImageInfo = &descriptors[writeCount].image;
+				}
+				writeCount++;
+			}
+			vkUpdateDescriptorSets(device, writeCount, descriptorWrites.data(), 0, nullptr);
+		}
+	}
+	double writeRate = updatesPerSecond(start);
 
-	stbi_image_free(pixels);
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (VkDescriptorSet set : sets)
+		{
+			descriptorWriter.update(set, descriptors.data());
+		}
+	}
+	double templateRate = updatesPerSecond(start);
 
-	// create vkimage
-	createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT,
-	            VK_FORMAT_R8G8B8A8_SRGB,
-	            VK_IMAGE_TILING_OPTIMAL,
-	            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+	std::cout << "descriptor update benchmark: " << setCount << " sets of " << descriptorWriter.getDescriptorCount()
+		<< " descriptors, " << rounds << " rounds" << std::endl;
+	std::cout << "  vkUpdateDescriptorSets: " << writeRate << " updates/s" << std::endl;
+	std::cout << "  update template: " << templateRate << " updates/s" << std::endl;
 
-	// transition image layout to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	if (!pushDescriptorsSupported)
+	{
+		std::cout << "  push descriptors: VK_KHR_push_descriptor not supported" << std::endl;
+		return;
+	}
 
-	// Execute the buffer to image copy operation
-	copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-	// transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+	// Push descriptor layouts can't hold dynamic buffers, the offset would go into the pushed buffer info
+	std::vector<VkDescriptorSetLayoutBinding> pushBindings = descriptorSetBindings;
+	pushBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 
-	// To be able to start sampling from the texture image in the shader, we need one last transition to prepare it for shader access
-	// transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-	//                       VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+	layoutInfo.bindingCount = static_cast<uint32_t>(pushBindings.size());
+	layoutInfo.pBindings = pushBindings.data();
+	VkDescriptorSetLayout pushSetLayout = descriptorLayoutCache.get(layoutInfo);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &pushSetLayout;
+
+	VkPipelineLayout pushPipelineLayout;
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pushPipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create pipeline layout!");
+	}
+
+	DescriptorWriter pushWriter;
+	pushWriter.createPush(device, pushBindings, VK_PIPELINE_BIND_POINT_GRAPHICS, pushPipelineLayout, 0,
+	                      cmdPushDescriptorSetWithTemplate);
+
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+
+	start = std::chrono::high_resolution_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		vkResetCommandBuffer(commandBuffer, 0);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to begin recording command buffer!");
+		}
+		for (uint32_t i = 0; i < setCount; i++)
+		{
+			pushWriter.push(commandBuffer, descriptors.data());
+		}
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to record command buffer!");
+		}
+	}
+	std::cout << "  push descriptors: " << updatesPerSecond(start) << " updates/s" << std::endl;
+
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	pushWriter.destroy();
+	vkDestroyPipelineLayout(device, pushPipelineLayout, nullptr);
+}
+
+void HelloTriangleApplication::createDescriptorLayoutCache()
+{
+	descriptorLayoutCache.create(device);
+}
+
+void HelloTriangleApplication::destroyDescriptorLayoutCache()
+{
+	descriptorLayoutCache.destroy();
+}
+
+void HelloTriangleApplication::createDescriptorAllocators()
+{
+	// Set 0: a uniform buffer, the texture and with virtual texturing the page table, page atlas and feedback buffer
+	std::vector<DescriptorAllocator::PoolRatio> ratios = {
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f}
+	};
+
+	frameDescriptorAllocators.resize(MAX_FRAMES_IN_FLIGHT);
+	for (auto& allocator : frameDescriptorAllocators)
+	{
+		allocator.create(device, DESCRIPTOR_SETS_PER_POOL, ratios);
+	}
+}
+
+void HelloTriangleApplication::destroyDescriptorAllocators()
+{
+	for (auto& allocator : frameDescriptorAllocators)
+	{
+		allocator.destroy();
+	}
+}
+
+void HelloTriangleApplication::createDescriptorSets()
+{
+	// Recording allocates every frame's own, these are for whatever runs before the first frame
+	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		descriptorSets[i] = allocateDescriptorSet(i);
+	}
+
+	// The bindless path samples the same texture through its slot in set 1
+	if (bindlessTexturesSupported)
+	{
+		modelMaterial.textureIndex = bindlessTextures.add(textureImageView, textureSampler);
+	}
+}
+
+// Set 0 for a frame, valid until its allocator is reset
+VkDescriptorSet HelloTriangleApplication::allocateDescriptorSet(uint32_t frame)
+{
+	VkDescriptorSet descriptorSet = frameDescriptorAllocators[frame].allocate(descriptorSetLayout);
+	descriptorWriter.update(descriptorSet, getSetDescriptors(frame).data());
+	return descriptorSet;
+}
+
+std::array<DescriptorWriter::Descriptor, 5> HelloTriangleApplication::getSetDescriptors(uint32_t frame)
+{
+	// In binding order, the virtual texture ones are left out of the template when it is disabled
+	std::array<DescriptorWriter::Descriptor, 5> descriptors{};
+
+	// The range is one frame's uniforms, the dynamic offset slides it over the buffer
+	descriptors[0].buffer.buffer = uniformBuffers[frame];
+	descriptors[0].buffer.offset = 0;
+	descriptors[0].buffer.range = sizeof(UniformBufferObject);
+
+	descriptors[1].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	descriptors[1].image.imageView = textureImageView;
+	descriptors[1].image.sampler = textureSampler;
+
+	// Virtual texture, every frame in flight writes its own feedback buffer
+	if (virtualTextureEnabled)
+	{
+		// The samplers are immutable, only the views are written
+		descriptors[2].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		descriptors[2].image.imageView = pageTableImageView;
+
+		descriptors[3].image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		descriptors[3].image.imageView = pageAtlasImageView;
+
+		descriptors[4].buffer.buffer = feedbackBuffers[frame];
+		descriptors[4].buffer.offset = 0;
+		descriptors[4].buffer.range = VK_WHOLE_SIZE;
+	}
+	return descriptors;
+}
+
+void HelloTriangleApplication::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
+                                           VkFormat format, VkImageTiling tiling,
+                                           VkImageUsageFlags usage,
+                                           VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory,
+                                           VkImageCreateFlags flags)
+{
+	if (!tryCreateImage(width, height, mipLevels, numSamples, format, tiling, usage, properties, image, imageMemory,
+	                    flags))
+	{
+		throw std::runtime_error("failed to allocate image memory!");
+	}
+}
+
+// Like createImage(), but returns false instead of throwing when the device is out of memory
+bool HelloTriangleApplication::tryCreateImage(uint32_t width, uint32_t height, uint32_t mipLevels,
+                                              VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling,
+                                              VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
+                                              VkImage& image, VkDeviceMemory& imageMemory, VkImageCreateFlags flags)
+{
+	// One dimensional images can be used to store an array of data or gradient,
+	// two dimensional images are mainly used for textures,
+	// and three dimensional images can be used to store voxel volumes, for example.
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format; // format of texels
+	// VK_IMAGE_TILING_LINEAR: Texels are laid out in row-major order like our pixels array
+	// VK_IMAGE_TILING_OPTIMAL: Texels are laid out in an implementation defined order for optimal access
+	imageInfo.tiling = tiling; // layout of pixels
+	// VK_IMAGE_LAYOUT_UNDEFINED: Not usable by the GPU and the very first transition will discard the texels.
+	// VK_IMAGE_LAYOUT_PREINITIALIZED: Not usable by the GPU, but the first transition will preserve the texels.
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage;
+	imageInfo.samples = numSamples;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.flags = flags;
+
+	if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create image!");
+	}
+
+	// allocate memory for image
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, image, &memRequirements);
+
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = memRequirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+
+	VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory);
+	if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+	{
+		vkDestroyImage(device, image, nullptr);
+		return false;
+	}
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate image memory!");
+	}
+
+	vkBindImageMemory(device, image, imageMemory, 0);
+	return true;
+}
+
+void HelloTriangleApplication::createTextureImage()
+{
+	if (TEXTURE_STREAMING)
+	{
+		createStreamedTextureImage();
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t sourceStamp = TutUtils::getFileStamp(TEXTURE_PATH);
+
+	// Pre-baked KTX2: memory mapped and copied level by level, no decode and no mipmap blits.
+	// Used if it was baked from the current source image (or the source isn't shipped at all).
+	Ktx2Texture ktx2;
+	if (ktx2.open(TEXTURE_KTX2_PATH) && (sourceStamp == 0 || ktx2.getSourceStamp() == sourceStamp) &&
+		isTextureFormatSupported(ktx2.getView().format))
+	{
+		createTextureImage(ktx2.getView());
+		std::cout << "texture load: " << TEXTURE_KTX2_PATH << " (ktx2) " << std::chrono::duration<double,
+			std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+		return;
+	}
+
+	// BC blocks are encoded once and baked into the KTX2 file for the next launch
+	if (COMPRESS_TEXTURES && textureCompressionBCSupported)
+	{
+		TextureData compressed = bakeTexture(TEXTURE_PATH, true);
+		Ktx2Texture::write(TEXTURE_KTX2_PATH, compressed.getView(), sourceStamp);
+		createTextureImage(compressed.getView());
+		std::cout << "texture load: " << TEXTURE_PATH << " (decode + encode) " << std::chrono::duration<double,
+			std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+		return;
+	}
+
+	// stb_image_resize mip chain, also the fallback when the GPU can do neither compute mipmaps nor linear blits
+	if (CPU_MIPMAPS || (!computeMipmapsSupported && !isLinearBlitSupported(VK_FORMAT_R8G8B8A8_SRGB)))
+	{
+		TextureData rgba = bakeTexture(TEXTURE_PATH, false);
+		createTextureImage(rgba.getView());
+		std::cout << "texture load: " << TEXTURE_PATH << " (decode + cpu mipmaps) " << std::chrono::duration<double,
+			std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+		return;
+	}
+
+	// Decoded straight into the staging buffer, the pixels never sit on the heap
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	uint32_t texWidth, texHeight;
+	decodeIntoStagingBuffer(TEXTURE_PATH, stagingBuffer, stagingBufferMemory, texWidth, texHeight);
+	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
+
+	createGpuMipmappedImage(stagingBuffer, texWidth, texHeight, mipLevels, computeMipmapsSupported, textureImage,
+	                        textureImageMemory);
+
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+
+	std::cout << "texture load: " << TEXTURE_PATH << (computeMipmapsSupported ? " (decode + compute) " : " (decode + blit) ") << std::chrono::duration<double,
+		std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+}
+
+void HelloTriangleApplication::createGpuMipmappedImage(const unsigned char* pixels, uint32_t width, uint32_t height,
+                                                       uint32_t mipLevels, bool compute, VkImage& image,
+                                                       VkDeviceMemory& imageMemory, VkQueryPool timestampPool)
+{
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(width) * height * 4;
+
+	// host visible memory
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
+	             stagingBufferMemory);
+
+	// copy pixel values to buffer
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+	memcpy(data, pixels, imageSize);
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	createGpuMipmappedImage(stagingBuffer, width, height, mipLevels, compute, image, imageMemory, timestampPool);
+
+	// Clean up staging resources
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	vkFreeMemory(device, stagingBufferMemory, nullptr);
+}
+
+void HelloTriangleApplication::createGpuMipmappedImage(VkBuffer stagingBuffer, uint32_t width, uint32_t height,
+                                                       uint32_t mipLevels, bool compute, VkImage& image,
+                                                       VkDeviceMemory& imageMemory, VkQueryPool timestampPool)
+{
+	// create vkimage
+	// sRGB formats are rarely usable as storage images, so for compute the image itself is UNORM.
+	// VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT still allows the sRGB view the shaders sample from.
+	if (compute)
+	{
+		createImage(width, height, mipLevels, VK_SAMPLE_COUNT_1_BIT,
+		            VK_FORMAT_R8G8B8A8_UNORM,
+		            VK_IMAGE_TILING_OPTIMAL,
+		            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT |
+		            VK_IMAGE_USAGE_STORAGE_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory,
+		            VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT);
+	}
+	else
+	{
+		createImage(width, height, mipLevels, VK_SAMPLE_COUNT_1_BIT,
+		            VK_FORMAT_R8G8B8A8_SRGB,
+		            VK_IMAGE_TILING_OPTIMAL,
+		            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+	}
+
+	// transition image layout to VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+	transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
+	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+
+	// Execute the buffer to image copy operation
+	copyBufferToImage(stagingBuffer, image, width, height);
+	// transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+
+	// Generate mipmaps
+	if (compute)
+	{
+		generateMipmapsCompute(image, width, height, mipLevels, timestampPool);
+	}
+	else
+	{
+		generateMipmaps(image, VK_FORMAT_R8G8B8A8_SRGB, static_cast<int32_t>(width), static_cast<int32_t>(height),
+		                mipLevels, timestampPool);
+	}
+}
+
+bool HelloTriangleApplication::decodeIntoStagingBuffer(const std::string& path, VkBuffer& stagingBuffer,
+                                                       VkDeviceMemory& stagingBufferMemory, uint32_t& width,
+                                                       uint32_t& height)
+{
+	MappedFile file;
+	if (!file.open(path) || !TextureDecoder::getInfo(file, width, height))
+	{
+		throw std::runtime_error("failed to load texture image!");
+	}
+	VkDeviceSize capacity = TextureDecoder::getDecodeCapacity(width, height);
+
+	// PNG unfiltering reads back the rows it just wrote, which crawls on write-combined memory,
+	// so the staging buffer is host cached whenever the device has such a memory type
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (isMemoryTypeAvailable(properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+	{
+		properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+	createBuffer(capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, properties, stagingBuffer, stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, capacity, 0, &data);
+	bool direct;
+	try
+	{
+		direct = TextureDecoder::decodeInto(file, static_cast<unsigned char*>(data), capacity);
+	}
+	catch (...)
+	{
+		vkUnmapMemory(device, stagingBufferMemory);
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		throw;
+	}
+	vkUnmapMemory(device, stagingBufferMemory);
+	return direct;
+}
+
+void HelloTriangleApplication::benchmarkUpload()
+{
+	// The usual path first: peak RSS only ever grows where it can't be reset, so this order keeps both numbers honest
+	VkImage image;
+	VkDeviceMemory imageMemory;
+	size_t pixelBytes = 0;
+
+	TutUtils::resetPeakResidentMemory();
+	size_t baseline = TutUtils::getPeakResidentMemory();
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceMemory stagingBufferMemory;
+		uint32_t width, height;
+		bool direct = decodeIntoStagingBuffer(UPLOAD_BENCHMARK_PATH, stagingBuffer, stagingBufferMemory, width, height);
+		uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+		createGpuMipmappedImage(stagingBuffer, width, height, levels, computeMipmapsSupported, image, imageMemory);
+		vkDestroyBuffer(device, stagingBuffer, nullptr);
+		vkFreeMemory(device, stagingBufferMemory, nullptr);
+		pixelBytes = static_cast<size_t>(width) * height * 4;
+		std::cout << "upload benchmark " << UPLOAD_BENCHMARK_PATH << " " << width << "x" << height
+			<< (direct ? "" : " (decoder output was copied)") << std::endl;
+	}
+	auto uploaded = std::chrono::high_resolution_clock::now();
+	size_t directPeak = TutUtils::getPeakResidentMemory() - baseline;
+	vkDestroyImage(device, image, nullptr);
+	vkFreeMemory(device, imageMemory, nullptr);
+
+	// Decode to the heap, then memcpy into staging
+	TutUtils::resetPeakResidentMemory();
+	baseline = TutUtils::getPeakResidentMemory();
+	auto copyStart = std::chrono::high_resolution_clock::now();
+	{
+		DecodedImage decoded = TextureDecoder::decodeFile(UPLOAD_BENCHMARK_PATH);
+		uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(std::max(decoded.width, decoded.height)))) + 1;
+		createGpuMipmappedImage(decoded.pixels.get(), decoded.width, decoded.height, levels, computeMipmapsSupported,
+		                        image, imageMemory);
+	}
+	auto copied = std::chrono::high_resolution_clock::now();
+	size_t copyPeak = TutUtils::getPeakResidentMemory() - baseline;
+	vkDestroyImage(device, image, nullptr);
+	vkFreeMemory(device, imageMemory, nullptr);
+
+	std::cout << "  decode into staging: " << std::chrono::duration<double, std::milli>(uploaded - start).count()
+		<< " ms, peak RSS +" << directPeak / (1024 * 1024) << " MB" << std::endl;
+	std::cout << "  decode + memcpy: " << std::chrono::duration<double, std::milli>(copied - copyStart).count()
+		<< " ms, peak RSS +" << copyPeak / (1024 * 1024) << " MB (pixels " << pixelBytes / (1024 * 1024) << " MB)"
+		<< std::endl;
+}
+
+TextureData HelloTriangleApplication::downloadTextureImage(VkImage image, uint32_t width, uint32_t height,
+                                                           uint32_t mipLevels)
+{
+	// RGBA8 levels, tightly packed one after another
+	TextureData texture;
+	texture.levels.resize(mipLevels);
+	VkDeviceSize size = 0;
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		texture.levels[i].width = std::max(width >> i, 1u);
+		texture.levels[i].height = std::max(height >> i, 1u);
+		texture.levels[i].data.resize(static_cast<size_t>(texture.levels[i].width) * texture.levels[i].height * 4);
+		size += texture.levels[i].data.size();
+	}
+
+	VkBuffer readbackBuffer;
+	VkDeviceMemory readbackBufferMemory;
+	createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readbackBuffer,
+	             readbackBufferMemory);
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+	                     VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     1, &barrier);
+
+	std::vector<VkBufferImageCopy> regions(mipLevels);
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		regions[i].bufferOffset = offset;
+		regions[i].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		regions[i].imageSubresource.mipLevel = i;
+		regions[i].imageSubresource.layerCount = 1;
+		regions[i].imageExtent = {texture.levels[i].width, texture.levels[i].height, 1};
+		offset += texture.levels[i].data.size();
+	}
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer,
+	                       static_cast<uint32_t>(regions.size()), regions.data());
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     1, &barrier);
+
+	endSingleTimeCommands(commandBuffer);
+
+	void* data;
+	vkMapMemory(device, readbackBufferMemory, 0, size, 0, &data);
+	const unsigned char* src = static_cast<const unsigned char*>(data);
+	for (auto& level : texture.levels)
+	{
+		memcpy(level.data.data(), src, level.data.size());
+		src += level.data.size();
+	}
+	vkUnmapMemory(device, readbackBufferMemory);
+
+	vkDestroyBuffer(device, readbackBuffer, nullptr);
+	vkFreeMemory(device, readbackBufferMemory, nullptr);
+	return texture;
+}
+
+void HelloTriangleApplication::benchmarkMipmaps()
+{
+	// Synthetic RGBA8 texture, a smooth gradient with a checker on top so the filters have something to chew on
+	TextureData source;
+	source.format = VK_FORMAT_R8G8B8A8_SRGB;
+	source.levels.resize(1);
+	TextureLevel& base = source.levels[0];
+	base.width = MIPMAP_BENCHMARK_SIZE;
+	base.height = MIPMAP_BENCHMARK_SIZE;
+	base.data.resize(static_cast<size_t>(base.width) * base.height * 4);
+	TutUtils::parallelFor(base.height, [&](uint32_t y)
+	{
+		unsigned char* row = &base.data[static_cast<size_t>(y) * base.width * 4];
+		for (uint32_t x = 0; x < base.width; x++)
+		{
+			unsigned char checker = ((x / 16) ^ (y / 16)) & 1 ? 64 : 0;
+			row[x * 4 + 0] = static_cast<unsigned char>(x * 255 / base.width) ^ checker;
+			row[x * 4 + 1] = static_cast<unsigned char>(y * 255 / base.height) ^ checker;
+			row[x * 4 + 2] = checker;
+			row[x * 4 + 3] = 255;
+		}
+	});
+	uint32_t levels = static_cast<uint32_t>(std::floor(std::log2(MIPMAP_BENCHMARK_SIZE))) + 1;
+
+	// GPU time is taken with a pair of timestamps around the mipmap commands only
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	VkQueryPool timestampPool = VK_NULL_HANDLE;
+	if (properties.limits.timestampComputeAndGraphics)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2;
+		if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &timestampPool) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create timestamp query pool!");
+		}
+	}
+	auto gpuMilliseconds = [&]()
+	{
+		if (timestampPool == VK_NULL_HANDLE) return 0.0;
+		uint64_t timestamps[2];
+		vkGetQueryPoolResults(device, timestampPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+		                      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+		return static_cast<double>(timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod / 1e6;
+	};
+
+	VkImage image;
+	VkDeviceMemory imageMemory;
+
+	// GPU: upload level 0, then a chain of linear blits
+	auto start = std::chrono::high_resolution_clock::now();
+	createGpuMipmappedImage(base.data.data(), base.width, base.height, levels, false, image, imageMemory, timestampPool);
+	auto blitted = std::chrono::high_resolution_clock::now();
+	double blitGpu = gpuMilliseconds();
+	vkDestroyImage(device, image, nullptr);
+	vkFreeMemory(device, imageMemory, nullptr);
+
+	// GPU: upload level 0, then the single pass compute downsampler, checked against the CPU box filter
+	double computeWall = 0.0;
+	double computeGpu = 0.0;
+	int maxError = 0;
+	if (computeMipmapsSupported)
+	{
+		auto computeStart = std::chrono::high_resolution_clock::now();
+		createGpuMipmappedImage(base.data.data(), base.width, base.height, levels, true, image, imageMemory, timestampPool);
+		computeWall = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - computeStart).count();
+		computeGpu = gpuMilliseconds();
+
+		TextureData result = downloadTextureImage(image, base.width, base.height, levels);
+		vkDestroyImage(device, image, nullptr);
+		vkFreeMemory(device, imageMemory, nullptr);
+
+		TextureData reference;
+		reference.levels.push_back(base);
+		MipGenerator::generateBox(reference, true);
+		for (size_t l = 1; l < reference.levels.size(); l++)
+		{
+			for (size_t i = 0; i < reference.levels[l].data.size(); i++)
+			{
+				maxError = std::max(maxError, std::abs(reference.levels[l].data[i] - result.levels[l].data[i]));
+			}
+		}
+	}
+
+	// CPU: stb_image_resize over all cores, then every level in one upload
+	auto cpuStart = std::chrono::high_resolution_clock::now();
+	MipGenerator::generate(source, true);
+	auto generated = std::chrono::high_resolution_clock::now();
+	uploadTextureImage(source.getView(), image, imageMemory);
+	auto uploaded = std::chrono::high_resolution_clock::now();
+	vkDestroyImage(device, image, nullptr);
+	vkFreeMemory(device, imageMemory, nullptr);
+
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timestampPool, nullptr);
+	}
+
+	std::cout << "mipmap benchmark " << MIPMAP_BENCHMARK_SIZE << "x" << MIPMAP_BENCHMARK_SIZE << ", " << levels
+		<< " levels on " << properties.deviceName << std::endl;
+	std::cout << "  gpu blit chain: " << blitGpu << " ms gpu, "
+		<< std::chrono::duration<double, std::milli>(blitted - start).count() << " ms with upload" << std::endl;
+	if (computeMipmapsSupported)
+	{
+		std::cout << "  gpu compute single pass: " << computeGpu << " ms gpu, " << computeWall << " ms with upload"
+			<< ", max error vs cpu box filter " << maxError << "/255 (tolerance " << MIPMAP_BENCHMARK_TOLERANCE
+			<< ")" << std::endl;
+	}
+	std::cout << "  cpu mitchell on " << TutUtils::getWorkerCount() << " threads: "
+		<< std::chrono::duration<double, std::milli>(generated - cpuStart).count() << " ms + upload "
+		<< std::chrono::duration<double, std::milli>(uploaded - generated).count() << " ms ("
+		<< source.getSize() / (1024 * 1024) << " MB)" << std::endl;
+
+	if (maxError > MIPMAP_BENCHMARK_TOLERANCE)
+	{
+		throw std::runtime_error("compute mipmaps don't match the cpu box filter!");
+	}
+}
+
+void HelloTriangleApplication::benchmarkDecode(const std::vector<std::string>& directories)
+{
+	std::vector<std::string> files;
+	for (const auto& directory : directories)
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(directory))
+		{
+			std::string extension = entry.path().extension().string();
+			if (entry.is_regular_file() && (extension == ".png" || extension == ".jpg" || extension == ".jpeg"))
+			{
+				files.push_back(entry.path().string());
+			}
+		}
+	}
+	if (files.empty())
+	{
+		throw std::runtime_error("no images to decode!");
+	}
+
+	// The same few images over and over, standing in for a scene with a lot of textures
+	const size_t imageCount = 64;
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < imageCount; i++)
+	{
+		paths.push_back(files[i % files.size()]);
+	}
+
+#if defined(STBI_SSE2)
+	const char* simd = "sse2";
+#elif defined(STBI_NEON)
+	const char* simd = "neon";
+#else
+	const char* simd = "none";
+#endif
+	std::cout << "decode benchmark: " << imageCount << " decodes of " << files.size() << " images, simd " << simd
+		<< std::endl;
+
+	auto run = [&](uint32_t workerCount)
+	{
+		TextureDecoder decoder(workerCount);
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::future<DecodedImage>> pending;
+		for (const auto& path : paths)
+		{
+			pending.push_back(decoder.decode(path));
+		}
+		// Images are dropped as soon as they are done, only the queue ahead of us stays decoded
+		size_t encodedSize = 0;
+		size_t decodedSize = 0;
+		for (auto& result : pending)
+		{
+			DecodedImage image = result.get();
+			encodedSize += image.sourceSize;
+			decodedSize += image.getSize();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::cout << "  " << workerCount << (workerCount == 1 ? " thread: " : " threads: ") << seconds * 1000.0
+			<< " ms, " << encodedSize / seconds / (1024.0 * 1024.0) << " MB/s encoded, "
+			<< decodedSize / seconds / (1024.0 * 1024.0) << " MB/s decoded" << std::endl;
+		return seconds;
+	};
+
+	double single = run(1);
+	double multi = run(TutUtils::getWorkerCount());
+	std::cout << "  speedup " << single / multi << "x" << std::endl;
+}
+
+TextureData HelloTriangleApplication::bakeTexture(const std::string& path, bool compress)
+{
+	DecodedImage image = TextureDecoder::decodeFile(path);
+
+	TextureData rgba;
+	rgba.format = VK_FORMAT_R8G8B8A8_SRGB;
+	rgba.levels.resize(1);
+	rgba.levels[0].width = image.width;
+	rgba.levels[0].height = image.height;
+	rgba.levels[0].data.assign(image.pixels.get(), image.pixels.get() + image.getSize());
+	image.pixels.reset();
+
+	// The whole mip chain is built on the CPU, BC blocks can't be blitted and are encoded up front
+	MipGenerator::generate(rgba, true);
+	if (!compress)
+	{
+		return rgba;
+	}
+
+	BlockFormat blockFormat = TextureCompression::pickColorFormat(rgba.levels[0]);
+	auto start = std::chrono::high_resolution_clock::now();
+	TextureData compressed = TextureCompression::compress(rgba, blockFormat, true);
+	auto end = std::chrono::high_resolution_clock::now();
+	double seconds = std::chrono::duration<double>(end - start).count();
+
+	uint64_t pixelCount = 0;
+	for (const auto& level : rgba.levels)
+	{
+		pixelCount += static_cast<uint64_t>(level.width) * level.height;
+	}
+	std::cout << "texture compression: " << (blockFormat == BlockFormat::BC1 ? "BC1" : "BC3") << ", "
+		<< rgba.levels.size() << " levels, " << TutUtils::getWorkerCount() << " threads, "
+		<< pixelCount / seconds / 1e6 << " Mpixels/s, VRAM " << rgba.getSize() << " -> " << compressed.getSize()
+		<< " bytes (" << 100.0 * (1.0 - static_cast<double>(compressed.getSize()) / rgba.getSize()) << "% saved)"
+		<< std::endl;
+
+	return compressed;
+}
+
+void HelloTriangleApplication::convertTextures(const std::string& directory, bool compress)
+{
+	for (const auto& entry : std::filesystem::directory_iterator(directory))
+	{
+		if (!entry.is_regular_file() || entry.path().extension() != ".png") continue;
+
+		std::string source = entry.path().string();
+		std::string target = entry.path().parent_path().append(entry.path().stem().string() + ".ktx2").string();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		TextureData texture = bakeTexture(source, compress);
+		Ktx2Texture::write(target, texture.getView(), TutUtils::getFileStamp(source));
+		auto baked = std::chrono::high_resolution_clock::now();
+
+		// Load time benchmark: what the runtime does with the PNG vs. with the baked file.
+		// Decoding alone, without any mip generation, is already the cheap end for the PNG.
+		TextureDecoder::decodeFile(source);
+		auto decoded = std::chrono::high_resolution_clock::now();
+
+		Ktx2Texture ktx2;
+		if (!ktx2.open(target))
+		{
+			throw std::runtime_error("failed to read back baked KTX2 texture!");
+		}
+		std::vector<unsigned char> staging(ktx2.getView().getSize());
+		unsigned char* dst = staging.data();
+		for (const auto& level : ktx2.getView().levels)
+		{
+			memcpy(dst, level.data, level.size);
+			dst += level.size;
+		}
+		auto mapped = std::chrono::high_resolution_clock::now();
+
+		std::cout << source << " -> " << target << ": " << texture.levels.size() << " levels, "
+			<< texture.getSize() << " bytes, baked in "
+			<< std::chrono::duration<double, std::milli>(baked - start).count() << " ms | load: png decode "
+			<< std::chrono::duration<double, std::milli>(decoded - baked).count() << " ms, ktx2 map + copy "
+			<< std::chrono::duration<double, std::milli>(mapped - decoded).count() << " ms" << std::endl;
+	}
+}
+
+bool HelloTriangleApplication::isTextureFormatSupported(VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+bool HelloTriangleApplication::isLinearBlitSupported(VkFormat format)
+{
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+}
+
+void HelloTriangleApplication::createTextureImage(const TextureView& texture)
+{
+	mipLevels = static_cast<uint32_t>(texture.levels.size());
+	textureFormat = texture.format;
+	uploadTextureImage(texture, textureImage, textureImageMemory);
+}
+
+void HelloTriangleApplication::uploadTextureImage(const TextureView& texture, VkImage& image, VkDeviceMemory& imageMemory)
+{
+	VkDeviceSize imageSize = texture.getSize();
+	uint32_t mipLevels = static_cast<uint32_t>(texture.levels.size());
+
+	// every level goes into one staging buffer, back to back
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+	             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
+	             stagingBufferMemory);
+
+	void* data;
+	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
+	char* dst = static_cast<char*>(data);
+	for (const auto& level : texture.levels)
+	{
+		memcpy(dst, level.data, level.size);
+		dst += level.size;
+	}
+	vkUnmapMemory(device, stagingBufferMemory);
+
+	// Also a transfer source, the texture streamer copies the levels it keeps out of it
+	createImage(texture.levels[0].width, texture.levels[0].height, mipLevels, VK_SAMPLE_COUNT_1_BIT,
+	            texture.format,
+	            VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory);
+
+	// No mipmap generation, every level is uploaded as is
+	transitionImageLayout(image, texture.format, VK_IMAGE_LAYOUT_UNDEFINED,
+	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
+	copyBufferToImage(stagingBuffer, image, texture);
+	transitionImageLayout(image, texture.format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
 
-	// Clean up staging resources
 	vkDestroyBuffer(device, stagingBuffer, nullptr);
 	vkFreeMemory(device, stagingBufferMemory, nullptr);
-
-	// Generate mipmaps
-	generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
 }
 
 void HelloTriangleApplication::destroyTextureImage()
@@ -1362,51 +3484,804 @@ void HelloTriangleApplication::destroyTextureImage()
 	vkFreeMemory(device, textureImageMemory, nullptr);
 }
 
-void HelloTriangleApplication::createTextureImageView()
+void HelloTriangleApplication::createTextureImageView()
+{
+	// The compute path creates the image UNORM with storage usage, which sRGB formats rarely support. The view is only
+	// ever sampled, so it says so and the storage usage isn't checked against its sRGB format.
+	VkImageUsageFlags viewUsage = computeMipmapsSupported ? VK_IMAGE_USAGE_SAMPLED_BIT : 0;
+	textureImageView = createImageView(textureImage, textureFormat, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, viewUsage);
+}
+
+void HelloTriangleApplication::destroyTextureImageView()
+{
+	vkDestroyImageView(device, textureImageView, nullptr);
+}
+
+void HelloTriangleApplication::createTextureSampler()
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.anisotropyEnable = VK_TRUE;
+	// Get physical device properties and check if requested anisotropy level is supported
+	samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE; // [0, 1)
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR; // linear blending between mip levels
+	// LODs count from the view's first level. A streamed texture's image only holds its resident levels, so this is
+	// the finest resident level and the sampler changes with every residency change, the cache keeps the old ones.
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(mipLevels - 1);
+	samplerInfo.mipLodBias = 0.0f;
+
+	textureSampler = samplerCache.get(samplerInfo);
+}
+
+void HelloTriangleApplication::createSamplerCache()
+{
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	samplerCache.create(device, properties.limits.maxSamplerAllocationCount);
+}
+
+void HelloTriangleApplication::destroySamplerCache()
+{
+	samplerCache.destroy();
+}
+
+void HelloTriangleApplication::createBindlessTextures()
+{
+	if (!bindlessTexturesSupported) return;
+
+	bindlessTextures.create(device, bindlessTextureCapacity);
+}
+
+void HelloTriangleApplication::destroyBindlessTextures()
+{
+	if (!bindlessTexturesSupported) return;
+
+	bindlessTextures.destroy();
+}
+
+void HelloTriangleApplication::benchmarkMaterials()
+{
+	// Every material shows the model's texture, but each one has a descriptor set, or a bindless slot, of its own.
+	// Only recording is timed, the command buffer is never submitted.
+	const uint32_t materialCount = BINDLESS_BENCHMARK_MATERIALS;
+	const int recordings = 100;
+
+	// Classic: one set per material, written like allocateDescriptorSet() does. They come from the first frame's
+	// allocator, which grows its pools to fit and hands them all back when that frame resets it.
+	std::vector<VkDescriptorSet> materialSets(materialCount);
+	auto writeStart = std::chrono::high_resolution_clock::now();
+	for (VkDescriptorSet& materialSet : materialSets)
+	{
+		materialSet = frameDescriptorAllocators[0].allocate(descriptorSetLayout);
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = uniformBuffers[0];
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = textureImageView;
+		imageInfo.sampler = textureSampler;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = materialSet;
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = materialSet;
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0,
+		                       nullptr);
+	}
+	auto writeEnd = std::chrono::high_resolution_clock::now();
+
+	// Bindless: one slot per material
+	bool bindless = bindlessTexturesSupported &&
+		bindlessTextures.getCapacity() - bindlessTextures.getCount() >= materialCount;
+	std::vector<MaterialConstants> materials(materialCount);
+	auto addStart = std::chrono::high_resolution_clock::now();
+	if (bindless)
+	{
+		for (auto& material : materials)
+		{
+			material.textureIndex = bindlessTextures.add(textureImageView, textureSampler);
+		}
+	}
+	auto addEnd = std::chrono::high_resolution_clock::now();
+
+	VkCommandBufferAllocateInfo commandBufferInfo{};
+	commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferInfo.commandPool = commandPool;
+	commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate command buffers!");
+	}
+
+	// Whatever the color pass draws with, each way gets the fragment shader it is written for: Shader.frag reads
+	// the texture of set 0, Bindless.frag indexes set 1 with the pushed material. They come from the library when
+	// the benchmark runs, a shader reload drops every pipeline built from the shader.
+	PipelineLibrary::Description classicPass = colorPassDescription;
+	classicPass.fragmentShader = getShaderPath(FRAG_SHADER_SOURCE, FRAG_SHADER_PATH);
+	classicPass.specialization = getShaderSpecialization(DEFAULT_SHADER_FEATURES);
+	PipelineLibrary::Description bindlessPass = colorPassDescription;
+	bindlessPass.fragmentShader = getShaderPath(BINDLESS_FRAG_SHADER_SOURCE, BINDLESS_FRAG_SHADER_PATH);
+	bindlessPass.specialization.clear();
+
+	// Records one draw per material, returns the average time per recording in ms
+	const uint32_t uniformOffset = 0;
+	uint32_t descriptorBinds = 0;
+	auto record = [&](bool useBindless)
+	{
+		const PipelineLibrary::Description& pass = useBindless ? bindlessPass : classicPass;
+		VkPipeline pipeline = pipelineLibrary.get(pass);
+		descriptorBinds = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < recordings; i++)
+		{
+			vkResetCommandBuffer(commandBuffer, 0);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to begin recording command buffer!");
+			}
+
+			std::array<VkClearValue, 2> clearValues{};
+			clearValues[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+			clearValues[1].depthStencil = {1.0f, 0};
+
+			VkRenderPassBeginInfo renderPassInfo{};
+			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			renderPassInfo.renderPass = renderPass;
+			renderPassInfo.framebuffer = swapChainFramebuffers[0];
+			renderPassInfo.renderArea.extent = swapChainExtent;
+			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+			renderPassInfo.pClearValues = clearValues.data();
+			vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			VkViewport viewport{0.0f, 0.0f, static_cast<float>(swapChainExtent.width),
+			                    static_cast<float>(swapChainExtent.height), 0.0f, 1.0f};
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			VkRect2D scissor{{0, 0}, swapChainExtent};
+			vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+			VkBuffer vertexBuffers[] = {vertexBuffer, vertexBuffer};
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			pipelineLibrary.setDynamicState(commandBuffer, pass);
+			vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, vertexStreamOffsets.data());
+			vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, modelDraw.indexType);
+
+			if (useBindless)
+			{
+				std::array<VkDescriptorSet, 2> sets = {descriptorSets[0], bindlessTextures.getSet()};
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 2,
+				                        sets.data(), 1, &uniformOffset);
+				descriptorBinds++;
+			}
+			DrawConstants drawConstants{};
+			drawConstants.model = modelMatrix;
+			vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags, 0, drawConstantRange.size,
+			                   &drawConstants);
+			for (uint32_t m = 0; m < materialCount; m++)
+			{
+				if (useBindless)
+				{
+					vkCmdPushConstants(commandBuffer, pipelineLayout, drawConstantRange.stageFlags,
+					                   offsetof(DrawConstants, material), sizeof(MaterialConstants), &materials[m]);
+				}
+				else
+				{
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
+					                        &materialSets[m], 1, &uniformOffset);
+					descriptorBinds++;
+				}
+				vkCmdDrawIndexed(commandBuffer, modelDraw.indexCount, 1, modelDraw.firstIndex, modelDraw.vertexOffset, 0);
+			}
+
+			vkCmdEndRenderPass(commandBuffer);
+			if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to record command buffer!");
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / recordings;
+	};
+
+	std::cout << "material benchmark: " << materialCount << " materials, average of " << recordings << " recordings"
+		<< std::endl;
+	double classicTime = record(false);
+	std::cout << "  descriptor set per material: " << descriptorBinds << " descriptor set binds, " << classicTime
+		<< " ms to record, " << std::chrono::duration<double, std::milli>(writeEnd - writeStart).count()
+		<< " ms to write the sets" << std::endl;
+	if (bindless)
+	{
+		double bindlessTime = record(true);
+		std::cout << "  bindless: " << descriptorBinds << " descriptor set bind + " << materialCount
+			<< " push constants, " << bindlessTime << " ms to record, "
+			<< std::chrono::duration<double, std::milli>(addEnd - addStart).count() << " ms to add the textures ("
+			<< bindlessTextures.getCount() << " / " << bindlessTextures.getCapacity() << " slots)" << std::endl;
+	}
+	else
+	{
+		std::cout << "  bindless: not supported" << std::endl;
+	}
+
+	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	if (bindless)
+	{
+		for (const auto& material : materials)
+		{
+			bindlessTextures.remove(material.textureIndex);
+		}
+	}
+}
+
+void HelloTriangleApplication::benchmarkSamplers()
+{
+	// Materials pick their sampler from a few filters, address modes and anisotropy levels,
+	// like an imported scene where every material spells out its own sampler
+	const uint32_t materialCount = SAMPLER_BENCHMARK_MATERIALS;
+	const std::array<VkFilter, 2> filters = {VK_FILTER_NEAREST, VK_FILTER_LINEAR};
+	const std::array<VkSamplerAddressMode, 3> addressModes = {
+		VK_SAMPLER_ADDRESS_MODE_REPEAT, VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE
+	};
+	const std::array<float, 2> anisotropies = {1.0f, 16.0f};
+
+	VkPhysicalDeviceProperties properties{};
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	auto getMaterialSampler = [&](uint32_t material)
+	{
+		float anisotropy = std::min(anisotropies[material / 6 % anisotropies.size()],
+		                            properties.limits.maxSamplerAnisotropy);
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = filters[material % filters.size()];
+		samplerInfo.minFilter = samplerInfo.magFilter;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.addressModeU = addressModes[material / 2 % addressModes.size()];
+		samplerInfo.addressModeV = samplerInfo.addressModeU;
+		samplerInfo.addressModeW = samplerInfo.addressModeU;
+		samplerInfo.anisotropyEnable = anisotropy > 1.0f ? VK_TRUE : VK_FALSE; // isDeviceSuitable() requires anisotropy
+		samplerInfo.maxAnisotropy = anisotropy;
+		samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		return samplerInfo;
+	};
+
+	SamplerCache::Stats before = samplerCache.getStats();
+	uint32_t samplersBefore = samplerCache.getSamplerCount();
+	std::vector<VkSampler> materialSamplers(materialCount);
+	auto cacheStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t material = 0; material < materialCount; material++)
+	{
+		materialSamplers[material] = samplerCache.get(getMaterialSampler(material));
+	}
+	auto cacheEnd = std::chrono::high_resolution_clock::now();
+	uint64_t requests = samplerCache.getStats().requests - before.requests;
+	uint64_t hits = samplerCache.getStats().hits - before.hits;
+
+	// Without the cache every material would own a sampler, which runs out of maxSamplerAllocationCount long
+	// before 100k. Time a few hundred to get the cost of one.
+	const uint32_t rawCount = std::min(256u, materialCount);
+	std::vector<VkSampler> rawSamplers(rawCount);
+	auto rawStart = std::chrono::high_resolution_clock::now();
+	for (uint32_t material = 0; material < rawCount; material++)
+	{
+		VkSamplerCreateInfo samplerInfo = getMaterialSampler(material);
+		if (vkCreateSampler(device, &samplerInfo, nullptr, &rawSamplers[material]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create texture sampler!");
+		}
+	}
+	auto rawEnd = std::chrono::high_resolution_clock::now();
+	for (VkSampler sampler : rawSamplers)
+	{
+		vkDestroySampler(device, sampler, nullptr);
+	}
+
+	// Cached samplers never go away, so a layout can bake them in as immutable samplers
+	VkDescriptorSetLayoutBinding samplerBinding{};
+	samplerBinding.binding = 0;
+	samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	samplerBinding.descriptorCount = 1;
+	samplerBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	samplerBinding.pImmutableSamplers = &materialSamplers[0];
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &samplerBinding;
+
+	descriptorLayoutCache.get(layoutInfo);
+
+	double cacheTime = std::chrono::duration<double, std::nano>(cacheEnd - cacheStart).count();
+	double rawTime = std::chrono::duration<double, std::nano>(rawEnd - rawStart).count();
+	std::cout << "sampler benchmark: " << materialCount << " materials" << std::endl;
+	std::cout << "  cache: " << samplerCache.getSamplerCount() - samplersBefore << " new samplers, "
+		<< static_cast<double>(hits) / requests * 100.0 << "% hit rate, " << cacheTime / materialCount
+		<< " ns per material" << std::endl;
+	std::cout << "  vkCreateSampler per material: " << rawTime / rawCount << " ns per material, "
+		<< materialCount << " samplers vs. a limit of " << properties.limits.maxSamplerAllocationCount
+		<< std::endl;
+}
+
+void HelloTriangleApplication::loadVirtualTexture()
+{
+	if (!VIRTUAL_TEXTURE) return;
+
+	if (!fragmentStoresSupported)
+	{
+		std::cout << "no fragmentStoresAndAtomics for the virtual texture feedback, the texture is used as is" << std::endl;
+		return;
+	}
+	const std::string& shaderPath = getShaderPath(VIRTUAL_TEXTURE_SHADER_SOURCE, VIRTUAL_TEXTURE_SHADER_PATH);
+	if (!std::filesystem::exists(shaderPath))
+	{
+		std::cout << shaderPath << " not found (see compile_shader.bat), the texture is used as is"
+			<< std::endl;
+		return;
+	}
+
+	// Rebuilt whenever the source image changed, like the KTX2 bake
+	uint64_t sourceStamp = TutUtils::getFileStamp(TEXTURE_PATH);
+	if (!virtualTexture.open(VIRTUAL_TEXTURE_PATH, sourceStamp, VIRTUAL_TEXTURE_ATLAS_PAGES))
+	{
+		buildVirtualTexture(TEXTURE_PATH, VIRTUAL_TEXTURE_PATH);
+		if (!virtualTexture.open(VIRTUAL_TEXTURE_PATH, sourceStamp, VIRTUAL_TEXTURE_ATLAS_PAGES))
+		{
+			throw std::runtime_error("failed to open virtual texture!");
+		}
+	}
+	virtualTextureEnabled = true;
+
+	std::cout << "virtual texture: " << VIRTUAL_TEXTURE_PATH << " " << virtualTexture.getWidth() << "x"
+		<< virtualTexture.getHeight() << ", " << virtualTexture.getLevelCount() << " levels, "
+		<< virtualTexture.getPageCount() << " pages, atlas of " << virtualTexture.getAtlasPages() *
+		virtualTexture.getAtlasPages() << " pages" << std::endl;
+}
+
+void HelloTriangleApplication::buildVirtualTexture(const std::string& imagePath, const std::string& path)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	DecodedImage image = TextureDecoder::decodeFile(imagePath);
+	VirtualTexture::build(path, image, TutUtils::getFileStamp(imagePath));
+	std::cout << "virtual texture build: " << imagePath << " -> " << path << " " << std::chrono::duration<double,
+		std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+}
+
+// Immutable samplers of set 0, so they exist before its layout
+void HelloTriangleApplication::createVirtualTextureSamplers()
+{
+	// The page table is read with texelFetch, integer formats can't be filtered anyway
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(virtualTexture.getLevelCount());
+	pageTableSampler = samplerCache.get(samplerInfo);
+
+	// Bilinear, the page borders keep the filter inside the page
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.maxLod = 0.0f;
+	pageAtlasSampler = samplerCache.get(samplerInfo);
+}
+
+void HelloTriangleApplication::createVirtualTextureResources()
+{
+	if (!virtualTextureEnabled) return;
+
+	// Page table: one texel per page, one mip level per level of the virtual texture
+	uint32_t levelCount = virtualTexture.getLevelCount();
+	createImage(virtualTexture.getPagesX(0), virtualTexture.getPagesY(0), levelCount, VK_SAMPLE_COUNT_1_BIT,
+	            VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	            pageTableImage, pageTableImageMemory);
+	transitionImageLayout(pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_UNDEFINED,
+	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+	transitionImageLayout(pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+	pageTableImageView = createImageView(pageTableImage, VK_FORMAT_R8G8B8A8_UINT, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                     levelCount);
+
+	// Page atlas: the physical pages, a single level since the shader picks the level itself
+	uint32_t atlasSize = virtualTexture.getAtlasPages() * VirtualTexture::TILE_SIZE;
+	createImage(atlasSize, atlasSize, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+	            pageAtlasImage, pageAtlasImageMemory);
+	transitionImageLayout(pageAtlasImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
+	                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+	transitionImageLayout(pageAtlasImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	                      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+	pageAtlasImageView = createImageView(pageAtlasImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+	// Per frame in flight, host visible: the CPU reads the feedback and fills the staging memory in place
+	VkDeviceSize feedbackSize = virtualTexture.getPageCount() * sizeof(uint32_t);
+	VkDeviceSize uploadSize = virtualTexture.getPageCount() * sizeof(VirtualTexture::PageTableEntry) +
+		VIRTUAL_TEXTURE_UPLOADS_PER_FRAME * VirtualTexture::TILE_BYTES;
+	feedbackBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	feedbackBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	feedbackBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	pageUploadBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	pageUploadBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	pageUploadBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		createBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, feedbackBuffers[i],
+		             feedbackBuffersMemory[i]);
+		vkMapMemory(device, feedbackBuffersMemory[i], 0, feedbackSize, 0, &feedbackBuffersMapped[i]);
+		memset(feedbackBuffersMapped[i], 0, feedbackSize);
+
+		createBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pageUploadBuffers[i],
+		             pageUploadBuffersMemory[i]);
+		vkMapMemory(device, pageUploadBuffersMemory[i], 0, uploadSize, 0, &pageUploadBuffersMapped[i]);
+	}
+}
+
+void HelloTriangleApplication::destroyVirtualTexture()
+{
+	if (!virtualTextureEnabled) return;
+
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		vkDestroyBuffer(device, feedbackBuffers[i], nullptr);
+		vkFreeMemory(device, feedbackBuffersMemory[i], nullptr);
+		vkDestroyBuffer(device, pageUploadBuffers[i], nullptr);
+		vkFreeMemory(device, pageUploadBuffersMemory[i], nullptr);
+	}
+	vkDestroyImageView(device, pageAtlasImageView, nullptr);
+	vkDestroyImage(device, pageAtlasImage, nullptr);
+	vkFreeMemory(device, pageAtlasImageMemory, nullptr);
+	vkDestroyImageView(device, pageTableImageView, nullptr);
+	vkDestroyImage(device, pageTableImage, nullptr);
+	vkFreeMemory(device, pageTableImageMemory, nullptr);
+	virtualTexture.close();
+}
+
+void HelloTriangleApplication::readVirtualTextureFeedback(uint32_t frame)
+{
+	if (!virtualTextureEnabled) return;
+
+	// Written by the frame that last used this slot, its fence has signalled
+	virtualTexture.processFeedback(static_cast<uint32_t*>(feedbackBuffersMapped[frame]));
+}
+
+void HelloTriangleApplication::recordVirtualTextureUploads(VkCommandBuffer commandBuffer)
+{
+	if (!virtualTextureEnabled) return;
+
+	// This frame's staging memory: the whole page table, then the pages
+	unsigned char* staging = static_cast<unsigned char*>(pageUploadBuffersMapped[currentFrame]);
+	const std::vector<VirtualTexture::PageTableEntry>& pageTable = virtualTexture.getPageTable();
+	VkDeviceSize pageTableSize = pageTable.size() * sizeof(VirtualTexture::PageTableEntry);
+	std::vector<VirtualTexture::PageUpload> uploads =
+		virtualTexture.collectPages(staging + pageTableSize, VIRTUAL_TEXTURE_UPLOADS_PER_FRAME);
+	if (uploads.empty()) return;
+	memcpy(staging, pageTable.data(), pageTableSize);
+
+	// Both images go to TRANSFER_DST and back. Barriers wait for all earlier work on the queue,
+	// so a frame still sampling a slot that is about to be replaced finishes first.
+	std::array<VkImageMemoryBarrier, 2> barriers{};
+	for (auto& barrier : barriers)
+	{
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	}
+	barriers[0].image = pageTableImage;
+	barriers[1].image = pageAtlasImage;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+	                     nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	// Page table, level by level
+	std::vector<VkBufferImageCopy> pageTableRegions(virtualTexture.getLevelCount());
+	for (uint32_t level = 0; level < virtualTexture.getLevelCount(); level++)
+	{
+		VkBufferImageCopy& region = pageTableRegions[level];
+		region.bufferOffset = virtualTexture.getLevelOffset(level) * sizeof(VirtualTexture::PageTableEntry);
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = level;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = {virtualTexture.getPagesX(level), virtualTexture.getPagesY(level), 1};
+	}
+	vkCmdCopyBufferToImage(commandBuffer, pageUploadBuffers[currentFrame], pageTableImage,
+	                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(pageTableRegions.size()),
+	                       pageTableRegions.data());
+
+	// One region per page, borders included
+	std::vector<VkBufferImageCopy> pageRegions(uploads.size());
+	for (size_t i = 0; i < uploads.size(); i++)
+	{
+		VkBufferImageCopy& region = pageRegions[i];
+		region.bufferOffset = pageTableSize + uploads[i].stagingOffset;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = {static_cast<int32_t>(uploads[i].slotX * VirtualTexture::TILE_SIZE),
+		                      static_cast<int32_t>(uploads[i].slotY * VirtualTexture::TILE_SIZE), 0};
+		region.imageExtent = {VirtualTexture::TILE_SIZE, VirtualTexture::TILE_SIZE, 1};
+	}
+	vkCmdCopyBufferToImage(commandBuffer, pageUploadBuffers[currentFrame], pageAtlasImage,
+	                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(pageRegions.size()),
+	                       pageRegions.data());
+
+	for (auto& barrier : barriers)
+	{
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0,
+	                     nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+}
+
+void HelloTriangleApplication::createStreamedTextureImage()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	uint64_t sourceStamp = TutUtils::getFileStamp(TEXTURE_PATH);
+
+	// The streamer uploads levels straight out of the KTX2 mapping, or out of a copy baked on the heap
+	TextureView source;
+	if (streamedTextureFile.open(TEXTURE_KTX2_PATH) &&
+		(sourceStamp == 0 || streamedTextureFile.getSourceStamp() == sourceStamp) &&
+		isTextureFormatSupported(streamedTextureFile.getView().format))
+	{
+		source = streamedTextureFile.getView();
+	}
+	else
+	{
+		streamedTextureData = bakeTexture(TEXTURE_PATH, COMPRESS_TEXTURES && textureCompressionBCSupported);
+		source = streamedTextureData.getView();
+	}
+
+	streamedTexture = textureStreamer.add(source, TEXTURE_STREAMING_INITIAL_SIZE);
+	createTextureImage(TextureStreamer::getLevels(source, textureStreamer.getFirstLevel(streamedTexture)));
+
+	std::cout << "texture load: " << TEXTURE_PATH << " (streamed, levels " << textureStreamer.getFirstLevel(
+		streamedTexture) << " to " << source.levels.size() - 1 << ") " << std::chrono::duration<double,
+		std::milli>(std::chrono::high_resolution_clock::now() - start).count() << " ms" << std::endl;
+}
+
+void HelloTriangleApplication::createTextureStreaming()
+{
+	if (!TEXTURE_STREAMING) return;
+
+	// Per frame in flight, at least as big as the finest level so every level fits on its own
+	textureStreamingBufferSize = std::max(TEXTURE_STREAMING_UPLOAD_SIZE,
+	                                      textureStreamer.getSource(streamedTexture).levels[0].size);
+	textureStreamingBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+	textureStreamingBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+	textureStreamingBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		createBuffer(textureStreamingBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		             textureStreamingBuffers[i], textureStreamingBuffersMemory[i]);
+		vkMapMemory(device, textureStreamingBuffersMemory[i], 0, textureStreamingBufferSize, 0,
+		            &textureStreamingBuffersMapped[i]);
+	}
+}
+
+void HelloTriangleApplication::destroyTextureStreaming()
 {
-	textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	if (!TEXTURE_STREAMING) return;
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	{
+		releaseRetiredTextures(i);
+		vkDestroyBuffer(device, textureStreamingBuffers[i], nullptr);
+		vkFreeMemory(device, textureStreamingBuffersMemory[i], nullptr);
+	}
 }
 
-void HelloTriangleApplication::destroyTextureImageView()
+VkDeviceSize HelloTriangleApplication::getTextureMemoryBudget()
 {
-	vkDestroyImageView(device, textureImageView, nullptr);
+	VkDeviceSize budget = std::min(TEXTURE_STREAMING_BUDGET, textureMemoryLimit);
+	if (!memoryBudgetSupported) return budget;
+
+	// heapBudget is what this process can use of the heap, other processes included.
+	// Textures may grow into a part of what is left on top of what they hold already.
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+	VkPhysicalDeviceMemoryProperties2 memoryProperties{};
+	memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memoryProperties.pNext = &budgetProperties;
+	vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(device, textureImage, &memRequirements);
+	uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	uint32_t heap = memoryProperties.memoryProperties.memoryTypes[memoryType].heapIndex;
+	VkDeviceSize available = budgetProperties.heapBudget[heap] > budgetProperties.heapUsage[heap]
+		                         ? budgetProperties.heapBudget[heap] - budgetProperties.heapUsage[heap]
+		                         : 0;
+	return std::min(budget, textureStreamer.getResidentSize() + available / 2);
 }
 
-void HelloTriangleApplication::createTextureSampler()
+void HelloTriangleApplication::recordTextureStreaming(VkCommandBuffer commandBuffer)
 {
-	VkPhysicalDeviceProperties properties{};
-	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	if (!TEXTURE_STREAMING) return;
 
-	VkSamplerCreateInfo samplerInfo{};
-	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-	samplerInfo.magFilter = VK_FILTER_LINEAR;
-	samplerInfo.minFilter = VK_FILTER_LINEAR;
-	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-	samplerInfo.anisotropyEnable = VK_TRUE;
-	// Get physical device properties and check if requested anisotropy level is supported
-	samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
-	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-	samplerInfo.unnormalizedCoordinates = VK_FALSE; // [0, 1)
-	samplerInfo.compareEnable = VK_FALSE;
-	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR; // linear blending between mip levels
-	samplerInfo.minLod = 0.0f; // Optional
-	samplerInfo.maxLod = static_cast<float>(mipLevels);
-	samplerInfo.mipLodBias = 0.0f;
-	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	textureStreamer.setScreenSize(streamedTexture, modelScreenSize);
+	textureStreamer.setBudget(getTextureMemoryBudget());
+	std::vector<TextureStreamer::Change> changes = textureStreamer.update(textureStreamingBufferSize);
 
-	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
+	// The model's texture is the only one registered, so this is textureImage
+	unsigned char* staging = static_cast<unsigned char*>(textureStreamingBuffersMapped[currentFrame]);
+	VkDeviceSize stagingOffset = 0;
+	for (const TextureStreamer::Change& change : changes)
 	{
-		throw std::runtime_error("failed to create texture sampler!");
+		const TextureView& source = textureStreamer.getSource(change.texture);
+		uint32_t levelCount = static_cast<uint32_t>(source.levels.size());
+		uint32_t newMipLevels = levelCount - change.firstLevel;
+
+		// Out of device memory: the texture keeps what it has and the budget stays below what is resident now
+		VkImage image;
+		VkDeviceMemory imageMemory;
+		if (!tryCreateImage(source.levels[change.firstLevel].width, source.levels[change.firstLevel].height,
+		                    newMipLevels, VK_SAMPLE_COUNT_1_BIT, textureFormat, VK_IMAGE_TILING_OPTIMAL,
+		                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+		                    VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, imageMemory))
+		{
+			textureMemoryLimit = textureStreamer.getResidentSize();
+			std::cout << "texture streaming: out of device memory, budget lowered to " << textureMemoryLimit / 1024
+				<< " KB" << std::endl;
+			continue;
+		}
+
+		// Levels the old image doesn't have go through this frame's staging buffer, 16 byte aligned for any format
+		std::vector<VkBufferImageCopy> uploads;
+		for (uint32_t level = change.firstLevel; level < change.oldFirstLevel; level++)
+		{
+			const TextureLevelView& src = source.levels[level];
+			memcpy(staging + stagingOffset, src.data, src.size);
+
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingOffset;
+			region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - change.firstLevel, 0, 1};
+			region.imageExtent = {src.width, src.height, 1};
+			uploads.push_back(region);
+			stagingOffset += (src.size + 15) & ~VkDeviceSize(15);
+		}
+
+		// The rest is copied over from the old image
+		std::vector<VkImageCopy> copies;
+		for (uint32_t level = std::max(change.firstLevel, change.oldFirstLevel); level < levelCount; level++)
+		{
+			VkImageCopy copy{};
+			copy.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - change.oldFirstLevel, 0, 1};
+			copy.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, level - change.firstLevel, 0, 1};
+			copy.extent = {source.levels[level].width, source.levels[level].height, 1};
+			copies.push_back(copy);
+		}
+
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		for (auto& barrier : barriers)
+		{
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			barrier.subresourceRange.baseMipLevel = 0;
+			barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+			barrier.subresourceRange.baseArrayLayer = 0;
+			barrier.subresourceRange.layerCount = 1;
+			barrier.srcAccessMask = 0;
+		}
+		barriers[0].image = textureImage;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1].image = image;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		                     0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		vkCmdCopyImage(commandBuffer, textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image,
+		               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+		if (!uploads.empty())
+		{
+			vkCmdCopyBufferToImage(commandBuffer, textureStreamingBuffers[currentFrame], image,
+			                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(uploads.size()),
+			                       uploads.data());
+		}
+
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		                     0, nullptr, 0, nullptr, 1, &barriers[1]);
+
+		// Frames in flight still sample the old image, it goes once this frame slot comes round again.
+		// The sampler for the new level count is most likely cached already.
+		RetiredTexture retired{textureImage, textureImageMemory, textureImageView, std::nullopt, currentFrame};
+		textureImage = image;
+		textureImageMemory = imageMemory;
+		mipLevels = newMipLevels;
+		createTextureImageView();
+		createTextureSampler();
+		if (bindlessTexturesSupported)
+		{
+			retired.bindlessSlot = modelMaterial.textureIndex;
+			modelMaterial.textureIndex = bindlessTextures.add(textureImageView, textureSampler);
+		}
+		retiredTextures.push_back(retired);
+
+		textureStreamer.setFirstLevel(change.texture, change.firstLevel);
 	}
 }
 
-void HelloTriangleApplication::destroyTextureSampler()
+void HelloTriangleApplication::releaseRetiredTextures(uint32_t frame)
 {
-	vkDestroySampler(device, textureSampler, nullptr);
+	// Retired while recording this slot's last frame, which has finished, and so have the ones before it
+	for (auto it = retiredTextures.begin(); it != retiredTextures.end();)
+	{
+		if (it->frame != frame)
+		{
+			++it;
+			continue;
+		}
+		vkDestroyImageView(device, it->view, nullptr);
+		vkDestroyImage(device, it->image, nullptr);
+		vkFreeMemory(device, it->memory, nullptr);
+		if (it->bindlessSlot.has_value())
+		{
+			bindlessTextures.remove(it->bindlessSlot.value());
+		}
+		it = retiredTextures.erase(it);
+	}
 }
 
 void HelloTriangleApplication::createDepthResources()
@@ -1458,7 +4333,6 @@ void HelloTriangleApplication::loadModel()
 			};
 
 			vertex.color = {1.0f, 1.0f, 1.0f};
-			vertices.push_back(vertex);
 
 			if (!uniqueVertices.contains(vertex))
 			{
@@ -1469,20 +4343,144 @@ void HelloTriangleApplication::loadModel()
 			indices.push_back(uniqueVertices[vertex]);
 		}
 	}
+
+	glm::vec3 boundsMin = vertices[0].pos;
+	glm::vec3 boundsMax = vertices[0].pos;
+	for (const auto& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+	modelBoundingSphere = glm::vec4((boundsMin + boundsMax) * 0.5f, glm::length(boundsMax - boundsMin) * 0.5f);
+
+	if (MODEL_VERTEX_FORMAT == VertexFormat::Compact)
+	{
+		compressVertices();
+	}
+}
+
+bool HelloTriangleApplication::isVertexFormatSupported(VkFormat format)
+{
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+	return (props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != 0;
+}
+
+// Quantize the mesh into CompactVertex
+// Positions are stored relative to the mesh bounds, so the error is bounded by half a step of the bounds divided in
+// 65535 steps on each axis. Every vertex is decoded again and checked against that bound before the mesh switches over.
+void HelloTriangleApplication::compressVertices()
+{
+	if (vertices.empty()) return;
+
+	glm::vec3 boundsMin = vertices[0].pos;
+	glm::vec3 boundsMax = vertices[0].pos;
+	glm::vec2 uvMin = vertices[0].texCoord;
+	glm::vec2 uvMax = vertices[0].texCoord;
+	for (const auto& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+		uvMin = glm::min(uvMin, vertex.texCoord);
+		uvMax = glm::max(uvMax, vertex.texCoord);
+	}
+	// Flat meshes still need a non zero extent to divide by
+	glm::vec3 extent = glm::max(boundsMax - boundsMin, glm::vec3(1e-6f));
+
+	bool unormTexCoords = uvMin.x >= 0.0f && uvMin.y >= 0.0f && uvMax.x <= 1.0f && uvMax.y <= 1.0f;
+	compactTexCoordFormat = unormTexCoords ? VK_FORMAT_R16G16_UNORM : VK_FORMAT_R16G16_SFLOAT;
+
+	if (!isVertexFormatSupported(VK_FORMAT_R16G16B16A16_UNORM) || !isVertexFormatSupported(VK_FORMAT_R8G8B8A8_UNORM) ||
+		!isVertexFormatSupported(compactTexCoordFormat))
+	{
+		std::cout << "compact vertex formats not supported, keeping full vertices" << std::endl;
+		return;
+	}
+
+	// half a quantization step, plus float slack for the decode
+	glm::vec3 posBound = extent / 65535.0f * 0.5f + extent * 1e-6f;
+	glm::vec3 maxPosError(0.0f);
+	float maxUvError = 0.0f;
+	float maxUvBound = 0.0f;
+
+	compactVertices.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& vertex = vertices[i];
+		CompactVertex& compact = compactVertices[i];
+
+		glm::vec3 normalized = glm::clamp((vertex.pos - boundsMin) / extent, 0.0f, 1.0f);
+		for (int c = 0; c < 3; c++)
+		{
+			compact.position.pos[c] = glm::packUnorm1x16(normalized[c]);
+		}
+		compact.position.pos[3] = 0;
+
+		compact.attributes.color = glm::packUnorm4x8(glm::vec4(vertex.color, 1.0f));
+
+		for (int c = 0; c < 2; c++)
+		{
+			float uv = vertex.texCoord[c];
+			float decoded;
+			float bound;
+			if (unormTexCoords)
+			{
+				compact.attributes.texCoord[c] = glm::packUnorm1x16(uv);
+				decoded = glm::unpackUnorm1x16(compact.attributes.texCoord[c]);
+				bound = 0.5f / 65535.0f + 1e-7f;
+			}
+			else
+			{
+				// half float keeps 11 significant bits, so rounding is off by at most 2^-11 relative
+				compact.attributes.texCoord[c] = glm::packHalf1x16(uv);
+				decoded = glm::unpackHalf1x16(compact.attributes.texCoord[c]);
+				bound = std::max(std::abs(uv), 6.1035e-5f) * 0.00048828125f;
+			}
+			maxUvError = std::max(maxUvError, std::abs(decoded - uv));
+			maxUvBound = std::max(maxUvBound, bound);
+			if (std::abs(decoded - uv) > bound)
+			{
+				throw std::runtime_error("texture coordinate quantization error out of bounds!");
+			}
+		}
+
+		glm::vec3 decodedPos(glm::unpackUnorm1x16(compact.position.pos[0]), glm::unpackUnorm1x16(compact.position.pos[1]),
+		                     glm::unpackUnorm1x16(compact.position.pos[2]));
+		glm::vec3 posError = glm::abs(boundsMin + decodedPos * extent - vertex.pos);
+		maxPosError = glm::max(maxPosError, posError);
+		if (glm::any(glm::greaterThan(posError, posBound)))
+		{
+			throw std::runtime_error("position quantization error out of bounds!");
+		}
+	}
+
+	// translate(min) * scale(extent) takes the unorm [0, 1] cube back to model space
+	vertexDequantize = glm::scale(glm::translate(glm::mat4(1.0f), boundsMin), extent);
+	vertexFormat = VertexFormat::Compact;
+
+	std::cout << "vertex compression: " << vertices.size() << " vertices, "
+		<< sizeof(Vertex) * vertices.size() << " -> " << sizeof(CompactVertex) * compactVertices.size() << " bytes"
+		<< ", max position error " << glm::max(maxPosError.x, glm::max(maxPosError.y, maxPosError.z))
+		<< " (bound " << glm::max(posBound.x, glm::max(posBound.y, posBound.z)) << ")"
+		<< ", max uv error " << maxUvError << " (bound " << maxUvBound << ", "
+		<< (unormTexCoords ? "unorm16" : "half") << ")" << std::endl;
 }
 
 void HelloTriangleApplication::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight,
-                                               uint32_t mipLevels)
+                                               uint32_t mipLevels, VkQueryPool timestampPool)
 {
 	// Check if image format supports linear blitting
-	VkFormatProperties formatProperties;
-	vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-	if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+	if (!isLinearBlitSupported(imageFormat))
 	{
 		throw std::runtime_error("texture image format does not support linear blitting!");
 	}
 
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+	}
 
 	VkImageMemoryBarrier barrier{};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -1558,7 +4556,283 @@ void HelloTriangleApplication::generateMipmaps(VkImage image, VkFormat imageForm
 	                     0, nullptr,
 	                     1, &barrier);
 
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
+	}
+	endSingleTimeCommands(commandBuffer);
+}
+
+void HelloTriangleApplication::createDownsamplePipeline()
+{
+	const std::string& shaderPath = getShaderPath(DOWNSAMPLE_SHADER_SOURCE, DOWNSAMPLE_SHADER_PATH);
+	if (computeMipmapsSupported && !std::filesystem::exists(shaderPath))
+	{
+		std::cout << shaderPath << " not found (see compile_shader.bat), mipmaps are blitted" << std::endl;
+		computeMipmapsSupported = false;
+	}
+	if (!computeMipmapsSupported) return;
+
+	// binding 0: one storage view per level, the dispatch's first level followed by the ones it writes
+	// binding 1: the finished workgroup counter
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[0].descriptorCount = DOWNSAMPLE_MAX_LEVELS + 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	downsampleDescriptorSetLayout = descriptorLayoutCache.get(layoutInfo);
+
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DownsampleParams);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &downsampleDescriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &downsamplePipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create downsample pipeline layout!");
+	}
+
+	auto shaderCode = shaderCompiler.load(shaderPath);
+	VkShaderModule shaderModule = createShaderModule(shaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = downsamplePipelineLayout;
+
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &downsamplePipeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create downsample pipeline!");
+	}
+	vkDestroyShaderModule(device, shaderModule, nullptr);
+
+	createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+	             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, downsampleCounterBuffer, downsampleCounterBufferMemory);
+}
+
+void HelloTriangleApplication::destroyDownsamplePipeline()
+{
+	if (!computeMipmapsSupported) return;
+
+	vkDestroyBuffer(device, downsampleCounterBuffer, nullptr);
+	vkFreeMemory(device, downsampleCounterBufferMemory, nullptr);
+	vkDestroyPipeline(device, downsamplePipeline, nullptr);
+	vkDestroyPipelineLayout(device, downsamplePipelineLayout, nullptr);
+}
+
+void HelloTriangleApplication::generateMipmapsCompute(VkImage image, uint32_t texWidth, uint32_t texHeight,
+                                                      uint32_t mipLevels, VkQueryPool timestampPool)
+{
+	// One dispatch writes up to DOWNSAMPLE_MAX_LEVELS levels below its first level. Its last workgroup reduces the
+	// sixth of those on its own, so that has to fit in one tile, otherwise the dispatch stops at six levels.
+	struct Dispatch
+	{
+		uint32_t baseLevel;
+		uint32_t groupCountX;
+		uint32_t groupCountY;
+		DownsampleParams params;
+	};
+	std::vector<Dispatch> dispatches;
+	for (uint32_t baseLevel = 0; baseLevel + 1 < mipLevels;)
+	{
+		Dispatch dispatch{};
+		uint32_t width = std::max(texWidth >> baseLevel, 1u);
+		uint32_t height = std::max(texHeight >> baseLevel, 1u);
+		uint32_t levelCount = (std::max(width, height) >> 6) <= DOWNSAMPLE_TILE_SIZE ? DOWNSAMPLE_MAX_LEVELS : 6;
+		dispatch.baseLevel = baseLevel;
+		dispatch.groupCountX = (width + DOWNSAMPLE_TILE_SIZE - 1) / DOWNSAMPLE_TILE_SIZE;
+		dispatch.groupCountY = (height + DOWNSAMPLE_TILE_SIZE - 1) / DOWNSAMPLE_TILE_SIZE;
+		dispatch.params.size = glm::ivec2(width, height);
+		dispatch.params.levelCount = static_cast<int32_t>(std::min(levelCount, mipLevels - 1 - baseLevel));
+		dispatch.params.groupCount = static_cast<int32_t>(dispatch.groupCountX * dispatch.groupCountY);
+		dispatches.push_back(dispatch);
+		baseLevel += dispatch.params.levelCount;
+	}
+
+	uint32_t setCount = static_cast<uint32_t>(dispatches.size());
+	uint32_t viewsPerSet = DOWNSAMPLE_MAX_LEVELS + 1;
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[0].descriptorCount = setCount * viewsPerSet;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = setCount;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = setCount;
+
+	VkDescriptorPool pool;
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create downsample descriptor pool!");
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(setCount, downsampleDescriptorSetLayout);
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = pool;
+	allocInfo.descriptorSetCount = setCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	std::vector<VkDescriptorSet> sets(setCount);
+	if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to allocate downsample descriptor sets!");
+	}
+
+	// UNORM single level views, the shader converts from and to sRGB itself.
+	// Slots past the last level of a dispatch are never touched but must hold a valid view, they repeat the last level.
+	std::vector<VkImageView> views;
+	for (uint32_t i = 0; i < setCount; i++)
+	{
+		std::vector<VkDescriptorImageInfo> imageInfos(viewsPerSet);
+		for (uint32_t slot = 0; slot < viewsPerSet; slot++)
+		{
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = std::min(dispatches[i].baseLevel + slot, mipLevels - 1);
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = 1;
+
+			VkImageView view;
+			if (vkCreateImageView(device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create downsample image view!");
+			}
+			views.push_back(view);
+
+			imageInfos[slot].imageView = view;
+			imageInfos[slot].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = downsampleCounterBuffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(uint32_t);
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = sets[i];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptorWrites[0].descriptorCount = viewsPerSet;
+		descriptorWrites[0].pImageInfo = imageInfos.data();
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = sets[i];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+	}
+
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, timestampPool, 0, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, 0);
+	}
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipeline);
+
+	// Level 0 was just copied in, every level goes to GENERAL for storage access
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = mipLevels;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	for (uint32_t i = 0; i < setCount; i++)
+	{
+		// The next dispatch reads what the previous one wrote, and its counter starts over from zero
+		if (i > 0)
+		{
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer,
+			                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			                     VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			                     1, &memoryBarrier,
+			                     0, nullptr,
+			                     0, nullptr);
+		}
+		vkCmdFillBuffer(commandBuffer, downsampleCounterBuffer, 0, sizeof(uint32_t), 0);
+
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer,
+		                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		                     1, &memoryBarrier,
+		                     0, nullptr,
+		                     i == 0 ? 1 : 0, &barrier);
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, downsamplePipelineLayout, 0, 1, &sets[i],
+		                        0, nullptr);
+		vkCmdPushConstants(commandBuffer, downsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+		                   sizeof(DownsampleParams), &dispatches[i].params);
+		vkCmdDispatch(commandBuffer, dispatches[i].groupCountX, dispatches[i].groupCountY, 1);
+	}
+
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     1, &barrier);
+
+	if (timestampPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, 1);
+	}
 	endSingleTimeCommands(commandBuffer);
+
+	for (auto view : views)
+	{
+		vkDestroyImageView(device, view, nullptr);
+	}
+	vkDestroyDescriptorPool(device, pool, nullptr);
 }
 
 void HelloTriangleApplication::createColorResources()
@@ -1761,11 +5035,54 @@ void HelloTriangleApplication::copyBufferToImage(VkBuffer buffer, VkImage image,
 	endSingleTimeCommands(commandBuffer);
 }
 
+void HelloTriangleApplication::copyBufferToImage(VkBuffer buffer, VkImage image, const TextureView& texture)
+{
+	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+	// one region per mip level, the levels are packed back to back in the buffer
+	std::vector<VkBufferImageCopy> regions(texture.levels.size());
+	VkDeviceSize offset = 0;
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		VkBufferImageCopy& region = regions[i];
+		region.bufferOffset = offset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+
+		region.imageOffset = {0, 0, 0};
+		region.imageExtent = {texture.levels[i].width, texture.levels[i].height, 1};
+
+		offset += texture.levels[i].size;
+	}
+
+	vkCmdCopyBufferToImage(
+		commandBuffer,
+		buffer,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		static_cast<uint32_t>(regions.size()),
+		regions.data()
+	);
+
+	endSingleTimeCommands(commandBuffer);
+}
+
 VkImageView HelloTriangleApplication::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags,
-                                                      uint32_t mipLevels)
+                                                      uint32_t mipLevels, VkImageUsageFlags usage)
 {
+	// A subset of the image's usage the view is limited to, 0 for all of it
+	VkImageViewUsageCreateInfo usageInfo{};
+	usageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+	usageInfo.usage = usage;
+
 	VkImageViewCreateInfo viewInfo{};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.pNext = usage != 0 ? &usageInfo : nullptr;
 	viewInfo.image = image;
 	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	viewInfo.format = format;
@@ -1882,6 +5199,38 @@ bool HelloTriangleApplication::checkDeviceExtensionSupport(VkPhysicalDevice devi
 	return requiredExtensions.empty();
 }
 
+bool HelloTriangleApplication::isDeviceExtensionSupported(const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool HelloTriangleApplication::isMemoryTypeAvailable(VkMemoryPropertyFlags properties)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+	{
+		if ((memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 uint32_t HelloTriangleApplication::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 {
 	VkPhysicalDeviceMemoryProperties memProperties;
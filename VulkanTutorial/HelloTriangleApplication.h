@@ -26,7 +26,22 @@
 #include <vector>
 #include <array>
 #include <unordered_map>
-
+#include <chrono>
+
+#include "TextureCompression.h"
+#include "Ktx2.h"
+#include "MipGenerator.h"
+#include "TextureDecoder.h"
+#include "BindlessTextures.h"
+#include "VirtualTexture.h"
+#include "TextureStreamer.h"
+#include "SamplerCache.h"
+#include "UniformAllocator.h"
+#include "DescriptorAllocator.h"
+#include "DescriptorWriter.h"
+#include "PipelineLibrary.h"
+#include "ShaderCompiler.h"
+#include "ShaderReflection.h"
 
 //#include <vulkan/vulkan.h>
 
@@ -52,59 +67,114 @@
 //      * Submit the recorded command buffer
 //      * Present the swap chain image
 
+// Which vertex streams a pipeline reads
+// Vertices are uploaded as two tightly packed streams instead of one interleaved array:
+//  binding 0: positions only
+//  binding 1: every other attribute
+// so depth only passes fetch nothing but positions.
+enum class VertexStreams
+{
+	All,
+	PositionOnly
+};
+
 struct Vertex
 {
 	glm::vec3 pos;
 	glm::vec3 color;
 	glm::vec2 texCoord;
 
-	// Binding descriptions
-	static VkVertexInputBindingDescription getBindingDescription()
+	// Layout of one element of the attribute stream (binding 1), the position stream is a plain glm::vec3.
+	// The vertex input is reflected from the vertex shader, which packs the streams the same way.
+	struct Attributes
+	{
+		glm::vec3 color;
+		glm::vec2 texCoord;
+	};
+
+	bool operator==(const Vertex& other) const
+	{
+		return pos == other.pos && color == other.color && texCoord == other.texCoord;
+	}
+};
+
+// Vertex layouts a mesh can be uploaded with
+//  Full: 12 byte positions + 20 byte attributes, straight from Vertex
+//  Compact: 8 byte positions + 8 byte attributes from CompactVertex, quantized at load time
+enum class VertexFormat
+{
+	Full,
+	Compact
+};
+
+// Quantized vertex, half the size of Vertex
+//  pos: unorm16 relative to the mesh bounds, expanded again by the dequantize matrix folded into ubo.model
+//  color: RGBA8 unorm (loadModel() only ever writes white)
+//  texCoord: unorm16 when every uv of the mesh lies in [0, 1], half float otherwise
+// The vertex fetch converts all three to float, so Shader.vert reads them unchanged.
+struct CompactVertex
+{
+	// position stream (binding 0)
+	struct Position
+	{
+		uint16_t pos[4]; // w is padding, VK_FORMAT_R16G16B16_UNORM is not a mandatory vertex format
+	};
+
+	// attribute stream (binding 1)
+	struct Attributes
+	{
+		uint32_t color;
+		uint16_t texCoord[2];
+	};
+
+	Position position;
+	Attributes attributes;
+
+	static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexStreams streams)
 	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(streams == VertexStreams::All ? 2 : 1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(Position);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-		return bindingDescription;
+		if (streams == VertexStreams::All)
+		{
+			bindingDescriptions[1].binding = 1;
+			bindingDescriptions[1].stride = sizeof(Attributes);
+			bindingDescriptions[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+
+		return bindingDescriptions;
 	}
 
-	// Attribute descriptions
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
+	// texCoordFormat: VK_FORMAT_R16G16_UNORM or VK_FORMAT_R16G16_SFLOAT, picked per mesh when quantizing
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(
+		VertexStreams streams, VkFormat texCoordFormat)
 	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions(streams == VertexStreams::All ? 3 : 1);
 
 		// pos
 		attributeDescriptions[0].binding = 0;
 		attributeDescriptions[0].location = 0;
-		// float: VK_FORMAT_R32_SFLOAT
-		// vec2: VK_FORMAT_R32G32_SFLOAT
-		// vec3: VK_FORMAT_R32G32B32_SFLOAT
-		// vec4: VK_FORMAT_R32G32B32A32_SFLOAT
-		// ivec2: VK_FORMAT_R32G32_SINT, a 2-component vector of 32-bit signed integers
-		// uvec4: VK_FORMAT_R32G32B32A32_UINT, a 4-component vector of 32-bit unsigned integers
-		// double: VK_FORMAT_R64_SFLOAT, a double-precision (64-bit) float
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-
-		// color
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-
-		// texCoord
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
+		attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributeDescriptions[0].offset = offsetof(Position, pos);
 
-		return attributeDescriptions;
-	}
+		if (streams == VertexStreams::All)
+		{
+			// color
+			attributeDescriptions[1].binding = 1;
+			attributeDescriptions[1].location = 1;
+			attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+			attributeDescriptions[1].offset = offsetof(Attributes, color);
+
+			// texCoord
+			attributeDescriptions[2].binding = 1;
+			attributeDescriptions[2].location = 2;
+			attributeDescriptions[2].format = texCoordFormat;
+			attributeDescriptions[2].offset = offsetof(Attributes, texCoord);
+		}
 
-	bool operator==(const Vertex& other) const
-	{
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
+		return attributeDescriptions;
 	}
 };
 
@@ -121,6 +191,16 @@ namespace std
 	};
 }
 
+// Draw range of a mesh inside the vertex and index buffers
+// indexType is picked per mesh at upload: 16 bit whenever every index fits
+struct MeshDraw
+{
+	uint32_t indexCount = 0;
+	uint32_t firstIndex = 0;
+	int32_t vertexOffset = 0;
+	VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+};
+
 struct QueueFamilyIndices
 {
 	std::optional<uint32_t> graphicsFamily;
@@ -150,6 +230,17 @@ public:
 		cleanup();
 	}
 
+	// Offline texture baking: turns every .png in directory into a .ktx2 next to it
+	// (BC1/BC3 when compress is set, RGBA8 otherwise) and prints load times for both
+	static void convertTextures(const std::string& directory, bool compress);
+
+	// Decodes the .png / .jpg files in directories on one thread and on the whole TextureDecoder pool,
+	// printing MB/s for both
+	static void benchmarkDecode(const std::vector<std::string>& directories);
+
+	// Cuts the image at imagePath into the pages of a virtual texture container, see VirtualTexture
+	static void buildVirtualTexture(const std::string& imagePath, const std::string& path);
+
 private:
 	GLFWwindow* window;
 	VkInstance instance;
@@ -163,8 +254,30 @@ private:
 	const std::string STATUE_TEXTURE_PATH = "VulkanTutorial/image/statue.jpg";
 
 	// shader
+	// With RUNTIME_SHADERS the pipelines are built from the GLSL sources, compiled by shaderCompiler and cached in
+	// SHADER_CACHE_DIRECTORY. With SHADER_HOT_RELOAD saving a source rebuilds the pipelines that use it. Built
+	// without shaderc the .spv files are used, run compile_shader.bat first to build them from the sources.
 	const std::string VERTEX_SHADER_PATH = "VulkanTutorial/shader/vert.spv";
 	const std::string FRAG_SHADER_PATH = "VulkanTutorial/shader/frag.spv";
+	const std::string DEPTH_SHADER_PATH = "VulkanTutorial/shader/depth.spv";
+	const std::string BINDLESS_FRAG_SHADER_PATH = "VulkanTutorial/shader/bindless.spv";
+	const std::string VERTEX_SHADER_SOURCE = "VulkanTutorial/shader/Shader.vert";
+	const std::string FRAG_SHADER_SOURCE = "VulkanTutorial/shader/Shader.frag";
+	const std::string DEPTH_SHADER_SOURCE = "VulkanTutorial/shader/Depth.vert";
+	const std::string BINDLESS_FRAG_SHADER_SOURCE = "VulkanTutorial/shader/Bindless.frag";
+	const std::string SHADER_CACHE_DIRECTORY = "VulkanTutorial/content/shader_cache";
+	const bool RUNTIME_SHADERS = true;
+	const bool SHADER_HOT_RELOAD = true;
+	ShaderCompiler shaderCompiler;
+
+	// shader reflection
+	// Set 0, the push constant range of pipelineLayout and the vertex input of the full vertex format are read from
+	// the shaders by shaderReflection, which also owns pipelineLayout. Layouts are built once at startup, a hot
+	// reloaded shader has to keep to them. BENCHMARK_SHADER_REFLECTION parses the app's shaders
+	// SHADER_REFLECTION_BENCHMARK_MODULES times and builds layouts from them at startup.
+	const bool BENCHMARK_SHADER_REFLECTION = false;
+	const uint32_t SHADER_REFLECTION_BENCHMARK_MODULES = 500;
+	ShaderReflection shaderReflection;
 
 	// inflight frames
 	const int MAX_FRAMES_IN_FLIGHT = 2;
@@ -206,9 +319,91 @@ private:
 	std::vector<VkImageView> swapChainImageViews;
 
 	// Graphics pipeline
+	// Pipelines come from pipelineLibrary, which owns them. Its VkPipelineCache is saved to PIPELINE_CACHE_PATH on
+	// exit and loaded on the next launch.
+	// With DYNAMIC_PIPELINE_STATE the extended dynamic state the device has turns raster, depth and blend state into
+	// command buffer state, every bind is followed by pipelineLibrary.setDynamicState(). With PIPELINE_LIBRARIES
+	// pipelines are linked from VK_EXT_graphics_pipeline_library parts. BENCHMARK_PIPELINE_PERMUTATIONS compiles
+	// PIPELINE_PERMUTATIONS state permutations of the color pass as monolithic pipelines and with pipelineFeatures
+	// at startup.
+	const std::string PIPELINE_CACHE_PATH = "VulkanTutorial/content/pipeline.cache";
+	const bool DYNAMIC_PIPELINE_STATE = true;
+	const bool PIPELINE_LIBRARIES = true;
+	const bool BENCHMARK_PIPELINE_PERMUTATIONS = false;
+	const uint32_t PIPELINE_PERMUTATIONS = 64;
+	PipelineLibrary pipelineLibrary;
+	PipelineLibrary::Features pipelineFeatures;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
 	VkPipeline graphicsPipeline;
+	PipelineLibrary::Description colorPassDescription;
+
+	// Pipeline burst
+	// The B key (or BENCHMARK_PIPELINE_BURST at startup) asks for PIPELINE_BURST_VARIANTS variants of the color pass
+	// at once, every frame draws with the next one. With ASYNC_PIPELINES they compile on the library's workers and a
+	// frame whose variant isn't ready draws with the regular pipeline (PIPELINE_FALLBACK) or skips the model. Without,
+	// they are all compiled in the frame the burst starts in, like a synchronous rebuild. Until every variant exists
+	// the frames longer than FRAME_BUDGET_MS are counted.
+	struct PipelineBurst
+	{
+		bool active = false;
+		std::vector<PipelineLibrary::Description> variants;
+		uint32_t frames = 0;
+		uint32_t framesOverBudget = 0;
+		double frameTimeMax = 0.0; // ms
+		uint32_t fallbackDraws = 0;
+		uint32_t skippedDraws = 0;
+		std::chrono::high_resolution_clock::time_point start;
+	};
+	const bool BENCHMARK_PIPELINE_BURST = false;
+	const uint32_t PIPELINE_BURST_VARIANTS = 200;
+	const bool ASYNC_PIPELINES = true;
+	const bool PIPELINE_FALLBACK = true;
+	const double FRAME_BUDGET_MS = 1000.0 / 60.0;
+	bool pipelineBurstRequested = BENCHMARK_PIPELINE_BURST;
+	PipelineBurst pipelineBurst;
+
+	// Shader variants
+	// Shader.frag's features are specialization constants, every pipeline is built with the ShaderFeature bits it
+	// draws with and the compiler drops the code of the others. BENCHMARK_SHADER_VARIANTS draws the color pass
+	// SHADER_VARIANT_BENCHMARK_DRAWS times a frame for SHADER_VARIANT_BENCHMARK_FRAMES frames per combination of
+	// features, with the specialized pipeline and with the uber shader (compiled with UBER_SHADER, which reads the
+	// features from the push constants and branches on them), and compares their GPU time from timestamps.
+	// The uber shader is compiled at runtime, so the benchmark needs RUNTIME_SHADERS and shaderc.
+	enum ShaderFeature : uint32_t
+	{
+		SHADER_FEATURE_TEXTURE = 1,
+		SHADER_FEATURE_VERTEX_COLOR = 2,
+		SHADER_FEATURE_ALPHA_TEST = 4
+	};
+	struct VariantBenchmark
+	{
+		bool active = false;
+		std::vector<PipelineLibrary::Description> descriptions; // by configuration, features * 2 + uber
+		uint32_t configuration = 0; // recorded now
+		uint32_t frames = 0; // of this configuration
+		std::vector<double> gpuTime; // ms, summed by configuration
+		std::vector<uint32_t> samples;
+		double timestampPeriod = 0.0; // ns per tick
+		VkQueryPool queryPool = VK_NULL_HANDLE; // two timestamps per frame in flight
+		std::vector<bool> queryPending;
+		std::vector<uint32_t> queryConfiguration;
+	};
+	const uint32_t SHADER_FEATURE_COUNT = 3;
+	const uint32_t DEFAULT_SHADER_FEATURES = SHADER_FEATURE_TEXTURE;
+	const bool BENCHMARK_SHADER_VARIANTS = false;
+	const uint32_t SHADER_VARIANT_BENCHMARK_FRAMES = 100;
+	const uint32_t SHADER_VARIANT_BENCHMARK_DRAWS = 20;
+	VariantBenchmark variantBenchmark;
+
+	// Depth prepass
+	// The prepass lays down depth from the position stream only, then depthEqualPipeline shades
+	// each sample once with VK_COMPARE_OP_EQUAL and depth writes off. Toggled with the P key.
+	VkPipeline depthPrepassPipeline;
+	VkPipeline depthEqualPipeline;
+	PipelineLibrary::Description depthPrepassDescription;
+	PipelineLibrary::Description depthEqualDescription;
+	bool depthPrepassEnabled = true;
 
 	// Render pass
 	VkRenderPass renderPass;
@@ -226,20 +421,50 @@ private:
 	std::vector<VkFence> inFlightFences;
 
 	// Vertex buffer
+	// Holds the position stream followed by the attribute stream, bound at vertexStreamOffsets
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
+	std::array<VkDeviceSize, 2> vertexStreamOffsets{};
 
 	// Index buffer
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
-
+	VkDeviceSize indexBufferSize = 0;
+	MeshDraw modelDraw;
+
+	// Uniform buffers
+	// One UNIFORM_RING_SIZE buffer per frame in flight, persistently mapped. uniformAllocator hands out the frame's
+	// per-object uniforms from it and the draws find theirs through the dynamic offset of binding 0.
+	// BENCHMARK_UNIFORMS updates and binds UNIFORM_BENCHMARK_OBJECTS objects' uniforms that way and with a buffer
+	// and descriptor set per object at startup.
+	const VkDeviceSize UNIFORM_RING_SIZE = 1 << 20;
+	const bool BENCHMARK_UNIFORMS = false;
+	const uint32_t UNIFORM_BENCHMARK_OBJECTS = 10000;
 	std::vector<VkBuffer> uniformBuffers;
 	std::vector<VkDeviceMemory> uniformBuffersMemory;
 	std::vector<void*> uniformBuffersMapped;
-
-	// Descriptor pool
-	VkDescriptorPool descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
+	VkDeviceSize uniformBufferAlignment = 1; // minUniformBufferOffsetAlignment
+	UniformAllocator uniformAllocator;
+	uint32_t modelUniformOffset = 0; // dynamic offset of this frame's UniformBufferObject
+
+	// Descriptor sets
+	// Set 0 is allocated and written anew every frame from the frame's transient allocator, which is reset once the
+	// frame's fence has signalled. It always points at the current texture, streaming needs no descriptor bookkeeping.
+	// Pools start at DESCRIPTOR_SETS_PER_POOL sets and grow when they run out. Every set layout comes from
+	// descriptorLayoutCache.
+	// The set is written with descriptorWriter's update template from the array getSetDescriptors() fills.
+	// BENCHMARK_DESCRIPTOR_UPDATES writes DESCRIPTOR_UPDATE_BENCHMARK_SETS sets with vkUpdateDescriptorSets, with the
+	// template and, with VK_KHR_push_descriptor, pushes them into a command buffer at startup.
+	const uint32_t DESCRIPTOR_SETS_PER_POOL = 16;
+	const bool BENCHMARK_DESCRIPTOR_UPDATES = false;
+	const uint32_t DESCRIPTOR_UPDATE_BENCHMARK_SETS = 10000;
+	DescriptorLayoutCache descriptorLayoutCache;
+	std::vector<DescriptorAllocator> frameDescriptorAllocators;
+	std::vector<VkDescriptorSet> descriptorSets; // set 0 of the frame last recorded in each slot
+	std::vector<VkDescriptorSetLayoutBinding> descriptorSetBindings; // what descriptorSetLayout was created from
+	DescriptorWriter descriptorWriter;
+	bool pushDescriptorsSupported = false;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate = nullptr;
 
 	// Member variables
 	bool framebufferResized = false;
@@ -250,12 +475,167 @@ private:
 	VkDeviceMemory stagingBufferMemory;
 	VkImage textureImage;
 	VkDeviceMemory textureImageMemory;
-	uint32_t mipLevels;
+	uint32_t mipLevels; // of textureImage, only the resident ones when streaming
+	VkFormat textureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+
+	// Texture compression and baking
+	// TEXTURE_KTX2_PATH holds the texture with every mip level pre-baked, see convertTextures().
+	// Without it the texture is encoded to BC1 (BC3 with alpha) and baked on first launch,
+	// as long as COMPRESS_TEXTURES is set and the device reports textureCompressionBC.
+	const bool COMPRESS_TEXTURES = true;
+	const std::string TEXTURE_KTX2_PATH = "VulkanTutorial/content/viking_room.ktx2";
+	bool textureCompressionBCSupported = false;
+
+	// Mipmaps for uncompressed textures are generated on the GPU unless CPU_MIPMAPS is set, see MipGenerator.
+	// The GPU path is the compute downsampler when available, the blit chain otherwise.
+	// Formats that support neither always take the CPU path.
+	// BENCHMARK_MIPMAPS times all of them on a MIPMAP_BENCHMARK_SIZE squared texture at startup. The compute levels
+	// are checked against the CPU box filter and the benchmark fails if any texel is off by more than
+	// MIPMAP_BENCHMARK_TOLERANCE out of 255, which leaves room for rounding once per level.
+	const bool CPU_MIPMAPS = false;
+	const bool BENCHMARK_MIPMAPS = false;
+	const uint32_t MIPMAP_BENCHMARK_SIZE = 8192;
+	const int MIPMAP_BENCHMARK_TOLERANCE = 2;
+
+	// BENCHMARK_UPLOAD compares decoding UPLOAD_BENCHMARK_PATH straight into staging memory with
+	// decoding to the heap and copying, upload time and peak RSS
+	const bool BENCHMARK_UPLOAD = false;
+	const std::string UPLOAD_BENCHMARK_PATH = "VulkanTutorial/content/viking_room.png";
+
+	// Compute mipmaps
+	// shader/Downsample.comp writes up to DOWNSAMPLE_MAX_LEVELS levels per dispatch through one storage view per level.
+	// Used when COMPUTE_MIPMAPS is set, the shader is there (compiled at runtime like the others, or downsample.spv from
+	// compile_shader.bat) and the device can index storage image arrays.
+	struct DownsampleParams
+	{
+		glm::ivec2 size;
+		int32_t levelCount;
+		int32_t groupCount;
+	};
+	const bool COMPUTE_MIPMAPS = true;
+	const std::string DOWNSAMPLE_SHADER_PATH = "VulkanTutorial/shader/downsample.spv";
+	const std::string DOWNSAMPLE_SHADER_SOURCE = "VulkanTutorial/shader/Downsample.comp";
+	const uint32_t DOWNSAMPLE_MAX_LEVELS = 12;
+	const uint32_t DOWNSAMPLE_TILE_SIZE = 64;
+	bool computeMipmapsSupported = false;
+	VkDescriptorSetLayout downsampleDescriptorSetLayout;
+	VkPipelineLayout downsamplePipelineLayout;
+	VkPipeline downsamplePipeline;
+	VkBuffer downsampleCounterBuffer;
+	VkDeviceMemory downsampleCounterBufferMemory;
 
 	// Image view and Sampler
 	VkImageView textureImageView;
 	VkSampler textureSampler;
 
+	// Sampler cache
+	// Every sampler comes from samplerCache and stays alive until cleanup, equal create infos share one.
+	// BENCHMARK_SAMPLERS asks it for the samplers of SAMPLER_BENCHMARK_MATERIALS materials at startup,
+	// which only use a handful of distinct configurations.
+	const bool BENCHMARK_SAMPLERS = false;
+	const uint32_t SAMPLER_BENCHMARK_MATERIALS = 100000;
+	SamplerCache samplerCache;
+
+	// Bindless textures
+	// With BINDLESS_TEXTURES set and descriptor indexing available, every texture lives in bindlessTextures (set 1)
+	// and the color pipelines run shader/Bindless.frag, which picks its texture by the index in MaterialConstants.
+	// Set 0 keeps the uniform buffer and the single sampler for the classic path.
+	// BENCHMARK_BINDLESS records BINDLESS_BENCHMARK_MATERIALS draws, one material each, both ways at startup.
+	struct MaterialConstants
+	{
+		uint32_t textureIndex;
+	};
+	const bool BINDLESS_TEXTURES = true;
+	const uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+	const bool BENCHMARK_BINDLESS = false;
+	const uint32_t BINDLESS_BENCHMARK_MATERIALS = 1000;
+	bool bindlessTexturesSupported = false;
+	uint32_t bindlessTextureCapacity = 0;
+	BindlessTextures bindlessTextures;
+	MaterialConstants modelMaterial{};
+
+	// Push constants
+	// The model matrix changes with every draw, so it is pushed with the draw's material instead of going through the
+	// uniform buffer, which keeps what stays the same for the frame (view and projection).
+	// One range for both stages: the vertex stage reads the model, Bindless.frag the material and the uber shader
+	// variant of Shader.frag the features. drawConstantRange is what the shaders declare of it, only those bytes
+	// are pushed.
+	// BENCHMARK_PUSH_CONSTANTS records PUSH_CONSTANT_BENCHMARK_DRAWS draws with their model matrix pushed and with it
+	// written to the uniform buffer and bound by dynamic offset at startup.
+	struct DrawConstants
+	{
+		glm::mat4 model;
+		MaterialConstants material;
+		uint32_t features; // ShaderFeature bits, read by the uber shader only
+	};
+	const bool BENCHMARK_PUSH_CONSTANTS = false;
+	const uint32_t PUSH_CONSTANT_BENCHMARK_DRAWS = 10000;
+	VkPushConstantRange drawConstantRange{};
+	glm::mat4 modelMatrix{1.0f};
+
+	// Virtual texturing
+	// With VIRTUAL_TEXTURE set the model samples TEXTURE_PATH as a virtual texture through shader/VirtualTexture.frag.
+	// VIRTUAL_TEXTURE_PATH is built on first launch (or with --build-virtual-texture), after that only the pages the
+	// feedback asks for are loaded, into an atlas of VIRTUAL_TEXTURE_ATLAS_PAGES squared slots and at most
+	// VIRTUAL_TEXTURE_UPLOADS_PER_FRAME pages a frame. Needs fragmentStoresAndAtomics for the feedback writes.
+	// The page table, atlas and feedback buffer are bindings 2 to 4 of set 0.
+	const bool VIRTUAL_TEXTURE = false;
+	const std::string VIRTUAL_TEXTURE_PATH = "VulkanTutorial/content/viking_room.vtex";
+	const std::string VIRTUAL_TEXTURE_SHADER_PATH = "VulkanTutorial/shader/virtual.spv";
+	const std::string VIRTUAL_TEXTURE_SHADER_SOURCE = "VulkanTutorial/shader/VirtualTexture.frag";
+	const uint32_t VIRTUAL_TEXTURE_ATLAS_PAGES = 16;
+	const uint32_t VIRTUAL_TEXTURE_UPLOADS_PER_FRAME = 16;
+	bool fragmentStoresSupported = false;
+	bool virtualTextureEnabled = false;
+	VirtualTexture virtualTexture;
+	VkImage pageTableImage;
+	VkDeviceMemory pageTableImageMemory;
+	VkImageView pageTableImageView;
+	VkSampler pageTableSampler;
+	VkImage pageAtlasImage;
+	VkDeviceMemory pageAtlasImageMemory;
+	VkImageView pageAtlasImageView;
+	VkSampler pageAtlasSampler;
+	// One of each per frame in flight: the pages the frame asked for, and the page table and pages staged for it
+	std::vector<VkBuffer> feedbackBuffers;
+	std::vector<VkDeviceMemory> feedbackBuffersMemory;
+	std::vector<void*> feedbackBuffersMapped;
+	std::vector<VkBuffer> pageUploadBuffers;
+	std::vector<VkDeviceMemory> pageUploadBuffersMemory;
+	std::vector<void*> pageUploadBuffersMapped;
+
+	// Texture streaming
+	// With TEXTURE_STREAMING set the model's texture starts with the coarsest levels that fit in
+	// TEXTURE_STREAMING_INITIAL_SIZE. Finer levels are streamed in as the model grows on screen, and dropped again
+	// when textures need more than TEXTURE_STREAMING_BUDGET, or than VK_EXT_memory_budget says the heap has left.
+	// Each change re-creates textureImage with the new levels, copying over the ones it keeps, and uploads at most
+	// TEXTURE_STREAMING_UPLOAD_SIZE bytes a frame. Replaced images live on until their frame slot comes round again.
+	struct RetiredTexture
+	{
+		VkImage image;
+		VkDeviceMemory memory;
+		VkImageView view;
+		std::optional<uint32_t> bindlessSlot;
+		uint32_t frame;
+	};
+	const bool TEXTURE_STREAMING = false;
+	const VkDeviceSize TEXTURE_STREAMING_BUDGET = 1024 * 1024;
+	const VkDeviceSize TEXTURE_STREAMING_INITIAL_SIZE = 64 * 1024;
+	const VkDeviceSize TEXTURE_STREAMING_UPLOAD_SIZE = 1024 * 1024;
+	bool memoryBudgetSupported = false;
+	TextureStreamer textureStreamer;
+	uint32_t streamedTexture = 0;
+	Ktx2Texture streamedTextureFile; // the source levels, mapped ...
+	TextureData streamedTextureData; // ... or baked on the heap when there is no up to date KTX2
+	VkDeviceSize textureMemoryLimit = ~VkDeviceSize(0); // lowered when an allocation runs out of device memory
+	float modelScreenSize = 0.0f; // pixels, from updateUniformBuffer()
+	glm::vec4 modelBoundingSphere{0.0f}; // center and radius in model space
+	std::vector<RetiredTexture> retiredTextures;
+	std::vector<VkBuffer> textureStreamingBuffers;
+	std::vector<VkDeviceMemory> textureStreamingBuffersMemory;
+	std::vector<void*> textureStreamingBuffersMapped;
+	VkDeviceSize textureStreamingBufferSize = 0;
+
 	// Depth
 	VkImage depthImage;
 	VkDeviceMemory depthImageMemory;
@@ -293,10 +673,56 @@ private:
 	std::vector<uint32_t> indices;
 	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
 
+	// Vertex compression
+	// MODEL_VERTEX_FORMAT is what loadModel() asks for, vertexFormat is what the mesh ended up with
+	const VertexFormat MODEL_VERTEX_FORMAT = VertexFormat::Compact;
+	VertexFormat vertexFormat = VertexFormat::Full;
+	std::vector<CompactVertex> compactVertices;
+	VkFormat compactTexCoordFormat = VK_FORMAT_R16G16_UNORM;
+	glm::mat4 vertexDequantize{1.0f}; // maps unorm16 positions back to the mesh bounds
+
+	// Pipeline statistics, one query per frame in flight wrapped around the render pass.
+	// Results are picked up after the frame's fence instead of stalling on them.
+	struct PipelineStatistics
+	{
+		// in the order vkGetQueryPoolResults writes them, by ascending VkQueryPipelineStatisticFlagBits
+		uint64_t inputAssemblyVertices = 0;
+		uint64_t inputAssemblyPrimitives = 0;
+		uint64_t vertexShaderInvocations = 0;
+		uint64_t clippingInvocations = 0;
+		uint64_t clippingPrimitives = 0;
+		uint64_t fragmentShaderInvocations = 0;
+	};
+	const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+	bool pipelineStatisticsSupported = false;
+	VkQueryPool statisticsQueryPool = VK_NULL_HANDLE;
+	std::vector<bool> statisticsQueryPending;
+
+	// Frame stats, printed once per second
+	struct FrameStats
+	{
+		uint32_t frameCount = 0;
+		double frameTimeSum = 0.0; // ms
+		double frameTimeMax = 0.0; // ms
+		uint32_t statisticsCount = 0;
+		PipelineStatistics statisticsSum;
+		VirtualTexture::Stats virtualTextureStats; // as of the last report
+		TextureStreamer::Stats textureStreamingStats; // as of the last report
+		uint64_t descriptorAllocations = 0; // as of the last report
+		std::chrono::high_resolution_clock::time_point lastFrame;
+		std::chrono::high_resolution_clock::time_point lastReport;
+	};
+	FrameStats frameStats;
+
 	// Uniform buffer
 	struct UniformBufferObject
 	{
-		glm::mat4 model;
 		glm::mat4 view;
 		glm::mat4 proj;
 	};
@@ -354,8 +780,28 @@ private:
 	void destroyImageViews();
 
 	// Graphics Pipeline
+	void createShaderCompiler();
+	void destroyShaderCompiler();
+	void createShaderReflection();
+	void destroyShaderReflection();
+	const ShaderReflection::Module& reflectShader(const std::string& path, const std::vector<std::string>& defines = {});
+	std::vector<const ShaderReflection::Module*> getPipelineLayoutShaders();
+	void benchmarkShaderReflection();
+	const std::string& getShaderPath(const std::string& source, const std::string& binary) const;
+	void reloadChangedShaders();
+	void createPipelineLibrary();
+	void destroyPipelineLibrary();
 	void createGraphicsPipeline();
 	void destroyGraphicsPipeline();
+	void startPipelineBurst();
+	VkPipeline getBurstPipeline(VkPipeline fallback, const PipelineLibrary::Description*& description);
+	void updatePipelineBurst(double frameTime);
+	void benchmarkPipelinePermutations();
+	std::vector<uint32_t> getShaderSpecialization(uint32_t features) const;
+	void startVariantBenchmark();
+	void recordVariantBenchmark(VkCommandBuffer commandBuffer);
+	void readVariantTimestamps(uint32_t frame);
+	void finishVariantBenchmark();
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
 	// Render Pass
@@ -374,6 +820,11 @@ private:
 
 	// Draw
 	void drawFrame();
+	void updateFrameStats();
+	void reportFrameStats();
+	void createStatisticsQueryPool();
+	void destroyStatisticsQueryPool();
+	void readPipelineStatistics(uint32_t frame);
 	void createSyncObjects();
 	void destroySyncObjects();
 
@@ -391,28 +842,79 @@ private:
 
 	// Uniform buffer
 	void createDescriptorSetLayout();
-	void destroyDescriptorSetLayout();
 	void createUniformBuffers();
 	void destroyUniformBuffers();
 	void updateUniformBuffer(uint32_t currentImage);
-
-	// Descriptor pool
-	void createDescriptorPool();
+	void benchmarkUniforms();
+	void benchmarkPushConstants();
+
+	// Descriptor sets
+	void createDescriptorLayoutCache();
+	void destroyDescriptorLayoutCache();
+	void createDescriptorAllocators();
+	void destroyDescriptorAllocators();
 	void createDescriptorSets();
-	void destroyDescriptorPool();
+	VkDescriptorSet allocateDescriptorSet(uint32_t frame);
+	std::array<DescriptorWriter::Descriptor, 5> getSetDescriptors(uint32_t frame);
+	void benchmarkDescriptorUpdates();
 	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format,
 	                 VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-	                 VkImage& image, VkDeviceMemory& imageMemory);
+	                 VkImage& image, VkDeviceMemory& imageMemory, VkImageCreateFlags flags = 0);
+	bool tryCreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
+	                    VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
+	                    VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory,
+	                    VkImageCreateFlags flags = 0);
 
 	// Images
 	void createTextureImage();
 	void destroyTextureImage();
+	static TextureData bakeTexture(const std::string& path, bool compress);
+	bool isTextureFormatSupported(VkFormat format);
+	void createTextureImage(const TextureView& texture);
+	void uploadTextureImage(const TextureView& texture, VkImage& image, VkDeviceMemory& imageMemory);
+	bool isLinearBlitSupported(VkFormat format);
+	void createGpuMipmappedImage(const unsigned char* pixels, uint32_t width, uint32_t height, uint32_t mipLevels,
+	                             bool compute, VkImage& image, VkDeviceMemory& imageMemory,
+	                             VkQueryPool timestampPool = VK_NULL_HANDLE);
+	void createGpuMipmappedImage(VkBuffer stagingBuffer, uint32_t width, uint32_t height, uint32_t mipLevels,
+	                             bool compute, VkImage& image, VkDeviceMemory& imageMemory,
+	                             VkQueryPool timestampPool = VK_NULL_HANDLE);
+	bool decodeIntoStagingBuffer(const std::string& path, VkBuffer& stagingBuffer, VkDeviceMemory& stagingBufferMemory,
+	                             uint32_t& width, uint32_t& height);
+	void benchmarkUpload();
+	TextureData downloadTextureImage(VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels);
+	void benchmarkMipmaps();
 
 	// Image view and Sampler
 	void createTextureImageView();
 	void destroyTextureImageView();
 	void createTextureSampler();
-	void destroyTextureSampler();
+
+	// Sampler cache
+	void createSamplerCache();
+	void destroySamplerCache();
+	void benchmarkSamplers();
+
+	// Bindless textures
+	void createBindlessTextures();
+	void destroyBindlessTextures();
+	void benchmarkMaterials();
+
+	// Virtual texturing
+	void loadVirtualTexture();
+	void createVirtualTextureSamplers();
+	void createVirtualTextureResources();
+	void destroyVirtualTexture();
+	void readVirtualTextureFeedback(uint32_t frame);
+	void recordVirtualTextureUploads(VkCommandBuffer commandBuffer);
+
+	// Texture streaming
+	void createStreamedTextureImage();
+	void createTextureStreaming();
+	void destroyTextureStreaming();
+	VkDeviceSize getTextureMemoryBudget();
+	void recordTextureStreaming(VkCommandBuffer commandBuffer);
+	void releaseRetiredTextures(uint32_t frame);
 
 	// Depth
 	void createDepthResources();
@@ -420,9 +922,22 @@ private:
 
 	// loading models
 	void loadModel();
+	void compressVertices();
+	bool isVertexFormatSupported(VkFormat format);
+	VkDeviceSize getPositionStride();
+	VkDeviceSize getAttributeStride();
+	VkDeviceSize getVertexBufferSize();
+	void getVertexInputDescriptions(VertexStreams streams,
+	                                std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+	                                std::vector<VkVertexInputAttributeDescription>& attributeDescriptions);
 
 	// generate mipmaps
-	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels,
+	                     VkQueryPool timestampPool = VK_NULL_HANDLE);
+	void createDownsamplePipeline();
+	void destroyDownsamplePipeline();
+	void generateMipmapsCompute(VkImage image, uint32_t texWidth, uint32_t texHeight, uint32_t mipLevels,
+	                            VkQueryPool timestampPool = VK_NULL_HANDLE);
 
 	// Multisampling
 	void createColorResources();
@@ -432,6 +947,8 @@ private:
 	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	bool isDeviceExtensionSupported(const char* extensionName);
+	bool isMemoryTypeAvailable(VkMemoryPropertyFlags properties);
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
 	                  VkDeviceMemory& bufferMemory);
@@ -441,7 +958,9 @@ private:
 	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
 	                           uint32_t mipLevels);
 	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
+	void copyBufferToImage(VkBuffer buffer, VkImage image, const TextureView& texture);
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels,
+	                            VkImageUsageFlags usage = 0);
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling,
 	                             VkFormatFeatureFlags features);
 
@@ -451,6 +970,20 @@ private:
 		app->framebufferResized = true;
 	}
 
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
+	{
+		auto app = reinterpret_cast<HelloTriangleApplication*>(glfwGetWindowUserPointer(window));
+		if (key == GLFW_KEY_P && action == GLFW_PRESS)
+		{
+			app->depthPrepassEnabled = !app->depthPrepassEnabled;
+			std::cout << "depth prepass " << (app->depthPrepassEnabled ? "on" : "off") << std::endl;
+		}
+		if (key == GLFW_KEY_B && action == GLFW_PRESS)
+		{
+			app->pipelineBurstRequested = true;
+		}
+	}
+
 	VkFormat findDepthFormat()
 	{
 		return findSupportedFormat(
@@ -0,0 +1,363 @@
+//
+//  Ktx2.h
+//  VulkanTutorial
+//
+
+#ifndef Ktx2_h
+#define Ktx2_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "Utils.h"
+#include "TextureCompression.h"
+
+// KTX 2.0 texture container (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html)
+// Only what this sample bakes is supported: a single 2D image with a full mip chain, no supercompression,
+// in VK_FORMAT_R8G8B8A8_UNORM/SRGB or one of the BC1/BC3/BC4/BC5 formats.
+//
+// File layout:
+//  identifier, header, index, level index (level 0 first)
+//  data format descriptor, key/value data
+//  mip level data, smallest level first, every level aligned to lcm(texel block size, 4)
+//
+// The source image stamp (TutUtils::getFileStamp) is stored under the key "VulkanTutorial.sourceStamp",
+// so a stale file can be told apart from a fresh one.
+class Ktx2Texture
+{
+public:
+	// Memory maps the file and points the level views straight into the mapping.
+	// Returns false if the file is missing or not something this reader understands.
+	bool open(const std::string& filename)
+	{
+		view = {};
+		sourceStamp = 0;
+		if (!file.open(filename)) return false;
+
+		const unsigned char* data = file.data();
+		size_t size = file.size();
+		if (size < HEADER_SIZE || memcmp(data, IDENTIFIER, sizeof(IDENTIFIER)) != 0) return false;
+
+		Header header;
+		memcpy(&header, data + sizeof(IDENTIFIER), sizeof(header));
+		if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0 || header.layerCount > 1 ||
+			header.faceCount != 1 || header.levelCount == 0 || header.supercompressionScheme != 0 ||
+			size < HEADER_SIZE + static_cast<size_t>(header.levelCount) * sizeof(LevelIndex))
+		{
+			return false;
+		}
+
+		// A full chain ends at 1x1, a longer one would shift the size by 32 bits or more
+		uint32_t largest = std::max(header.pixelWidth, header.pixelHeight);
+		uint32_t maxLevelCount = 1;
+		while (maxLevelCount < 32 && (largest >> maxLevelCount) > 0) maxLevelCount++;
+		view.format = static_cast<VkFormat>(header.vkFormat);
+		if (header.levelCount > maxLevelCount || !isFormatSupported(view.format)) return false;
+
+		view.levels.resize(header.levelCount);
+		for (uint32_t i = 0; i < header.levelCount; i++)
+		{
+			LevelIndex level;
+			memcpy(&level, data + HEADER_SIZE + i * sizeof(LevelIndex), sizeof(level));
+			if (level.byteOffset > size || level.byteLength > size - level.byteOffset) return false;
+
+			view.levels[i].data = data + level.byteOffset;
+			view.levels[i].size = level.byteLength;
+			view.levels[i].width = std::max(header.pixelWidth >> i, 1u);
+			view.levels[i].height = std::max(header.pixelHeight >> i, 1u);
+
+			// The upload copies whole levels, a short one would read past the staging data
+			if (level.byteLength != getLevelSize(view.format, view.levels[i].width, view.levels[i].height))
+			{
+				return false;
+			}
+		}
+
+		// key/value pairs: uint32 length, "key\0value", padded to 4 bytes
+		if (header.kvdByteOffset <= size && header.kvdByteLength <= size - header.kvdByteOffset)
+		{
+			const unsigned char* kvd = data + header.kvdByteOffset;
+			uint32_t offset = 0;
+			while (offset + 4 <= header.kvdByteLength)
+			{
+				uint32_t length;
+				memcpy(&length, kvd + offset, 4);
+				if (length > header.kvdByteLength - offset - 4) break;
+
+				std::string entry(reinterpret_cast<const char*>(kvd + offset + 4), length);
+				size_t split = entry.find('\0');
+				if (split != std::string::npos && entry.compare(0, split, SOURCE_STAMP_KEY) == 0)
+				{
+					sourceStamp = std::strtoull(entry.c_str() + split + 1, nullptr, 10);
+				}
+				offset += (4 + length + 3) & ~3u;
+			}
+		}
+
+		return true;
+	}
+
+	const TextureView& getView() const
+	{
+		return view;
+	}
+
+	uint64_t getSourceStamp() const
+	{
+		return sourceStamp;
+	}
+
+	static bool isFormatSupported(VkFormat format)
+	{
+		return !buildDataFormatDescriptor(format).empty();
+	}
+
+	static void write(const std::string& filename, const TextureView& texture, uint64_t sourceStamp)
+	{
+		std::vector<uint32_t> dfd = buildDataFormatDescriptor(texture.format);
+		if (dfd.empty())
+		{
+			throw std::runtime_error("unsupported KTX2 texture format!");
+		}
+
+		std::vector<unsigned char> kvd;
+		appendKeyValue(kvd, "KTXwriter", "VulkanTutorial");
+		appendKeyValue(kvd, SOURCE_STAMP_KEY, std::to_string(sourceStamp));
+
+		uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+		uint32_t dfdOffset = static_cast<uint32_t>(HEADER_SIZE + levelCount * sizeof(LevelIndex));
+		uint32_t dfdLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+		uint32_t kvdOffset = dfdOffset + dfdLength;
+		uint32_t kvdLength = static_cast<uint32_t>(kvd.size());
+
+		// levels are stored smallest first, each aligned to lcm(texel block size, 4)
+		uint64_t alignment = getBlockSize(texture.format) % 4 == 0 ? getBlockSize(texture.format) : 4;
+		std::vector<LevelIndex> levelIndex(levelCount);
+		uint64_t offset = kvdOffset + kvdLength;
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			offset = (offset + alignment - 1) / alignment * alignment;
+			levelIndex[i].byteOffset = offset;
+			levelIndex[i].byteLength = texture.levels[i].size;
+			levelIndex[i].uncompressedByteLength = texture.levels[i].size;
+			offset += texture.levels[i].size;
+		}
+
+		Header header{};
+		header.vkFormat = static_cast<uint32_t>(texture.format);
+		header.typeSize = 1;
+		header.pixelWidth = texture.levels[0].width;
+		header.pixelHeight = texture.levels[0].height;
+		header.pixelDepth = 0;
+		header.layerCount = 0;
+		header.faceCount = 1;
+		header.levelCount = levelCount;
+		header.supercompressionScheme = 0;
+		header.dfdByteOffset = dfdOffset;
+		header.dfdByteLength = dfdLength;
+		header.kvdByteOffset = kvdOffset;
+		header.kvdByteLength = kvdLength;
+		header.sgdByteOffset = 0;
+		header.sgdByteLength = 0;
+
+		std::ofstream out(filename, std::ios::binary);
+		if (!out.is_open())
+		{
+			throw std::runtime_error("failed to open KTX2 file for writing!");
+		}
+		out.write(reinterpret_cast<const char*>(IDENTIFIER), sizeof(IDENTIFIER));
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(LevelIndex));
+		out.write(reinterpret_cast<const char*>(dfd.data()), dfdLength);
+		out.write(reinterpret_cast<const char*>(kvd.data()), kvdLength);
+
+		uint64_t written = kvdOffset + kvdLength;
+		const char zeros[16] = {};
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			out.write(zeros, static_cast<std::streamsize>(levelIndex[i].byteOffset - written));
+			out.write(reinterpret_cast<const char*>(texture.levels[i].data),
+			          static_cast<std::streamsize>(texture.levels[i].size));
+			written = levelIndex[i].byteOffset + levelIndex[i].byteLength;
+		}
+
+		if (!out)
+		{
+			throw std::runtime_error("failed to write KTX2 file!");
+		}
+	}
+
+private:
+	static constexpr unsigned char IDENTIFIER[12] = {
+		0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+	};
+	static constexpr const char* SOURCE_STAMP_KEY = "VulkanTutorial.sourceStamp";
+
+	// the 64 bit sgd fields sit at a 4 byte aligned offset inside the header
+#pragma pack(push, 4)
+	struct Header
+	{
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount;
+		uint32_t supercompressionScheme;
+		// index
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+#pragma pack(pop)
+	static_assert(sizeof(Header) == 68, "KTX2 header must be tightly packed");
+
+	struct LevelIndex
+	{
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	static constexpr size_t HEADER_SIZE = sizeof(IDENTIFIER) + sizeof(Header);
+
+	MappedFile file;
+	TextureView view;
+	uint64_t sourceStamp = 0;
+
+	static uint32_t getBlockSize(VkFormat format)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return 8;
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			return 16;
+		default:
+			return 4;
+		}
+	}
+
+	// 4x4 blocks for the BC formats, texels for RGBA8
+	static uint64_t getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		if (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB)
+		{
+			return static_cast<uint64_t>(width) * height * 4;
+		}
+		return (static_cast<uint64_t>(width) + 3) / 4 * ((static_cast<uint64_t>(height) + 3) / 4) * getBlockSize(format);
+	}
+
+	static void appendKeyValue(std::vector<unsigned char>& kvd, const std::string& key, const std::string& value)
+	{
+		uint32_t length = static_cast<uint32_t>(key.size() + 1 + value.size() + 1);
+		kvd.insert(kvd.end(), reinterpret_cast<const unsigned char*>(&length),
+		           reinterpret_cast<const unsigned char*>(&length) + 4);
+		kvd.insert(kvd.end(), key.begin(), key.end());
+		kvd.push_back(0);
+		kvd.insert(kvd.end(), value.begin(), value.end());
+		kvd.push_back(0);
+		kvd.resize((kvd.size() + 3) & ~size_t(3), 0);
+	}
+
+	// Khronos basic data format descriptor, as laid out in the Khronos Data Format Specification 1.3.
+	// Returns an empty vector for formats the writer doesn't handle.
+	static std::vector<uint32_t> buildDataFormatDescriptor(VkFormat format)
+	{
+		struct Sample
+		{
+			uint32_t bitOffset;
+			uint32_t bitLength;
+			uint32_t channelType;
+			uint32_t upper;
+		};
+
+		const uint32_t CHANNEL_LINEAR = 0x10; // alpha stays linear in sRGB formats
+		uint32_t colorModel;
+		uint32_t blockDimension; // (width - 1) | (height - 1) << 8
+		uint32_t bytesPlane0;
+		bool srgb = false;
+		std::vector<Sample> samples;
+
+		switch (format)
+		{
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			srgb = true;
+			[[fallthrough]];
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			colorModel = 1; // KHR_DF_MODEL_RGBSDA
+			blockDimension = 0;
+			bytesPlane0 = 4;
+			samples = {{0, 7, 0, 255}, {8, 7, 1, 255}, {16, 7, 2, 255}, {24, 7, 15u | (srgb ? CHANNEL_LINEAR : 0), 255}};
+			break;
+		case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			srgb = true;
+			[[fallthrough]];
+		case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			colorModel = 128; // KHR_DF_MODEL_BC1A
+			blockDimension = 3 | 3 << 8;
+			bytesPlane0 = 8;
+			samples = {{0, 63, 0, 0xFFFFFFFF}};
+			break;
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			srgb = true;
+			[[fallthrough]];
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			colorModel = 130; // KHR_DF_MODEL_BC3
+			blockDimension = 3 | 3 << 8;
+			bytesPlane0 = 16;
+			samples = {{0, 63, 15u | (srgb ? CHANNEL_LINEAR : 0), 0xFFFFFFFF}, {64, 63, 0, 0xFFFFFFFF}};
+			break;
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			colorModel = 131; // KHR_DF_MODEL_BC4
+			blockDimension = 3 | 3 << 8;
+			bytesPlane0 = 8;
+			samples = {{0, 63, 0, 0xFFFFFFFF}};
+			break;
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			colorModel = 132; // KHR_DF_MODEL_BC5
+			blockDimension = 3 | 3 << 8;
+			bytesPlane0 = 16;
+			samples = {{0, 63, 0, 0xFFFFFFFF}, {64, 63, 1, 0xFFFFFFFF}};
+			break;
+		default:
+			return {};
+		}
+
+		uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+		std::vector<uint32_t> dfd;
+		dfd.push_back(4 + blockSize); // dfdTotalSize
+		dfd.push_back(0); // vendorId = KHRONOS, descriptorType = BASICFORMAT
+		dfd.push_back(2 | blockSize << 16); // versionNumber 1.3
+		// colorPrimaries BT709, transferFunction sRGB or linear, flags alpha straight
+		dfd.push_back(colorModel | 1 << 8 | (srgb ? 2 : 1) << 16);
+		dfd.push_back(blockDimension);
+		dfd.push_back(bytesPlane0);
+		dfd.push_back(0);
+		for (const auto& sample : samples)
+		{
+			dfd.push_back(sample.bitOffset | sample.bitLength << 16 | sample.channelType << 24);
+			dfd.push_back(0); // samplePosition
+			dfd.push_back(0); // sampleLower
+			dfd.push_back(sample.upper);
+		}
+		return dfd;
+	}
+};
+
+#endif /* Ktx2_h */
@@ -0,0 +1,155 @@
+//
+//  MipGenerator.h
+//  VulkanTutorial
+//
+
+#ifndef MipGenerator_h
+#define MipGenerator_h
+
+#include <stb_image_resize.h>
+#include <vector>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#include "Utils.h"
+#include "TextureCompression.h"
+
+// CPU mip chain generation with stb_image_resize.
+// Unlike vkCmdBlitImage this works for any format (the result is uploaded, not blitted), filters with a
+// proper Mitchell (or any other stbir) kernel, and does the sRGB <-> linear conversion itself.
+//
+// Each level is resized from the one above it. A level is cut into horizontal tiles of TILE_ROWS output rows
+// which are resized in parallel, every tile reading the full source level so the filter sees across tile seams.
+// The small tail levels are not worth a task each and are resized one after another on a single worker.
+class MipGenerator
+{
+public:
+	static constexpr uint32_t TILE_ROWS = 64;
+
+	// Fills in levels 1..n of an RGBA8 texture, level 0 must already be set
+	static void generate(TextureData& rgba, bool srgb, stbir_filter filter = STBIR_FILTER_MITCHELL)
+	{
+		rgba.levels.resize(1);
+		while (rgba.levels.back().width > 1 || rgba.levels.back().height > 1)
+		{
+			const TextureLevel& src = rgba.levels.back();
+			TextureLevel dst;
+			dst.width = std::max(src.width / 2, 1u);
+			dst.height = std::max(src.height / 2, 1u);
+			dst.data.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+			rgba.levels.push_back(std::move(dst));
+		}
+
+		// Levels below this one fit in a single tile
+		size_t tailLevel = 1;
+		while (tailLevel < rgba.levels.size() && rgba.levels[tailLevel].height > TILE_ROWS)
+		{
+			tailLevel++;
+		}
+
+		for (size_t level = 1; level < tailLevel; level++)
+		{
+			uint32_t tileCount = (rgba.levels[level].height + TILE_ROWS - 1) / TILE_ROWS;
+			TutUtils::parallelFor(tileCount, [&](uint32_t tile)
+			{
+				resizeRows(rgba.levels[level - 1], rgba.levels[level], tile * TILE_ROWS,
+				           std::min((tile + 1) * TILE_ROWS, rgba.levels[level].height), srgb, filter);
+			});
+		}
+
+		for (size_t level = std::max<size_t>(tailLevel, 1); level < rgba.levels.size(); level++)
+		{
+			resizeRows(rgba.levels[level - 1], rgba.levels[level], 0, rgba.levels[level].height, srgb, filter);
+		}
+	}
+
+	// Plain 2x2 box filter in linear light, every level reduced from the one above it.
+	// The same filter shader/Downsample.comp runs, kept as the reference its output is checked against.
+	// The shader carries unquantized values between some levels, so expect a difference of a step or two.
+	static void generateBox(TextureData& rgba, bool srgb)
+	{
+		float toLinear[256];
+		for (int i = 0; i < 256; i++)
+		{
+			toLinear[i] = decode(static_cast<unsigned char>(i), srgb);
+		}
+
+		rgba.levels.resize(1);
+		while (rgba.levels.back().width > 1 || rgba.levels.back().height > 1)
+		{
+			const TextureLevel& src = rgba.levels.back();
+			TextureLevel dst;
+			dst.width = std::max(src.width / 2, 1u);
+			dst.height = std::max(src.height / 2, 1u);
+			dst.data.resize(static_cast<size_t>(dst.width) * dst.height * 4);
+
+			for (uint32_t y = 0; y < dst.height; y++)
+			{
+				// A one texel wide level reads its only texel twice
+				const unsigned char* row0 = &src.data[static_cast<size_t>(y * 2) * src.width * 4];
+				const unsigned char* row1 = &src.data[static_cast<size_t>(std::min(y * 2 + 1, src.height - 1)) * src.width * 4];
+				for (uint32_t x = 0; x < dst.width; x++)
+				{
+					uint32_t x0 = x * 2 * 4;
+					uint32_t x1 = std::min(x * 2 + 1, src.width - 1) * 4;
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						const float* lut = c == 3 ? nullptr : toLinear;
+						float sum = load(row0[x0 + c], lut) + load(row0[x1 + c], lut) +
+						            load(row1[x0 + c], lut) + load(row1[x1 + c], lut);
+						dst.data[(static_cast<size_t>(y) * dst.width + x) * 4 + c] = encode(sum * 0.25f, srgb && c != 3);
+					}
+				}
+			}
+
+			rgba.levels.push_back(std::move(dst));
+		}
+	}
+
+private:
+	// Alpha is linear and skips the lookup table
+	static float load(unsigned char value, const float* lut)
+	{
+		return lut ? lut[value] : value / 255.0f;
+	}
+
+	static float decode(unsigned char value, bool srgb)
+	{
+		float c = value / 255.0f;
+		if (!srgb) return c;
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	static unsigned char encode(float c, bool srgb)
+	{
+		if (srgb)
+		{
+			c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+		}
+		return static_cast<unsigned char>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+
+	// Writes output rows [firstRow, lastRow) of dst
+	static void resizeRows(const TextureLevel& src, TextureLevel& dst, uint32_t firstRow, uint32_t lastRow, bool srgb,
+	                       stbir_filter filter)
+	{
+		float xScale = static_cast<float>(dst.width) / src.width;
+		float yScale = static_cast<float>(dst.height) / src.height;
+		unsigned char* output = dst.data.data() + static_cast<size_t>(firstRow) * dst.width * 4;
+
+		// Textures are sampled with VK_SAMPLER_ADDRESS_MODE_REPEAT, so the filter wraps around the edges too
+		int result = stbir_resize_subpixel(src.data.data(), static_cast<int>(src.width), static_cast<int>(src.height), 0,
+		                                   output, static_cast<int>(dst.width), static_cast<int>(lastRow - firstRow), 0,
+		                                   STBIR_TYPE_UINT8, 4, 3, 0,
+		                                   STBIR_EDGE_WRAP, STBIR_EDGE_WRAP, filter, filter,
+		                                   srgb ? STBIR_COLORSPACE_SRGB : STBIR_COLORSPACE_LINEAR, nullptr,
+		                                   xScale, yScale, 0.0f, static_cast<float>(firstRow));
+		if (!result)
+		{
+			throw std::runtime_error("failed to resize mip level!");
+		}
+	}
+};
+
+#endif /* MipGenerator_h */
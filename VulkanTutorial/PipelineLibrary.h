@@ -0,0 +1,1141 @@
+//
+//  PipelineLibrary.h
+//  VulkanTutorial
+//
+
+#ifndef PipelineLibrary_h
+#define PipelineLibrary_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
+#include <deque>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+
+#include "Utils.h"
+
+// Graphics pipeline library
+// A pipeline is asked for by a Description of everything that differs between pipelines: shaders, vertex layout,
+// raster, depth and blend state, and the layout and render pass it has to be compatible with. Pipelines are created
+// the first time their description is asked for and kept in a hash map until destroy(). compile() creates a batch of
+// missing ones up front on worker threads, which all feed the same VkPipelineCache (it synchronizes itself). The
+// cache's data can be saved and handed to create() on the next launch, so the driver skips what it compiled before.
+// Viewport and scissor are always dynamic. Shader modules are loaded once per path and live as long as the library.
+// request() is the asynchronous way: it queues the pipeline for worker threads that stay around and returns
+// VK_NULL_HANDLE until it is done, the caller draws with a fallback or skips the draw meanwhile. Finished pipelines
+// only become visible in publish(), called once a frame, so a frame never sees the set of pipelines change halfway.
+// Features the device has cut the number of pipelines down:
+//   - with extended dynamic state (1 and 3) the cull mode, front face, depth state, polygon mode, blending and write
+//     mask are set on the command buffer by setDynamicState() after binding, and left out of the key. Topology only
+//     keeps its class (points, lines, triangles). Extended dynamic state 2 covers nothing the descriptions vary.
+//   - with graphics pipeline libraries a pipeline is linked from four parts (vertex input, pre-rasterization,
+//     fragment shader, fragment output), each cached under just the fields it depends on. New combinations of known
+//     parts only cost the link, which skips link time optimization to stay fast.
+class PipelineLibrary
+{
+public:
+	struct Description
+	{
+		// Paths for the ShaderLoader, no fragment shader for depth only pipelines
+		std::string vertexShader;
+		std::string fragmentShader;
+		// Variants: defines of both shaders at compile time ("NAME" or "NAME=VALUE"), and specialization constants of
+		// the fragment shader, constant_id i gets specialization[i]. Ids the shader doesn't declare are ignored.
+		std::vector<std::string> defines;
+		std::vector<uint32_t> specialization;
+
+		// From addVertexLayout()
+		uint32_t vertexLayout = 0;
+		VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		// Rasterization
+		VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+		VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+		VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+		float minSampleShading = 0.0f; // 0 turns sample shading off
+
+		// Depth
+		VkBool32 depthTest = VK_TRUE;
+		VkBool32 depthWrite = VK_TRUE;
+		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+
+		// One color attachment, blending is source alpha over
+		VkBool32 blend = VK_FALSE;
+		VkColorComponentFlags colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		// Compatibility
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		uint32_t subpass = 0;
+
+		bool operator==(const Description& other) const
+		{
+			return vertexShader == other.vertexShader && fragmentShader == other.fragmentShader &&
+				defines == other.defines && specialization == other.specialization &&
+				vertexLayout == other.vertexLayout && topology == other.topology &&
+				polygonMode == other.polygonMode && cullMode == other.cullMode && frontFace == other.frontFace &&
+				samples == other.samples && minSampleShading == other.minSampleShading &&
+				depthTest == other.depthTest && depthWrite == other.depthWrite &&
+				depthCompareOp == other.depthCompareOp && blend == other.blend &&
+				colorWriteMask == other.colorWriteMask && layout == other.layout &&
+				renderPass == other.renderPass && subpass == other.subpass;
+		}
+	};
+
+	struct DescriptionHash
+	{
+		size_t operator()(const Description& description) const
+		{
+			size_t hash = 0;
+			auto combine = [&hash](size_t value)
+			{
+				hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+			};
+			combine(std::hash<std::string>()(description.vertexShader));
+			combine(std::hash<std::string>()(description.fragmentShader));
+			for (const std::string& define : description.defines)
+			{
+				combine(std::hash<std::string>()(define));
+			}
+			for (uint32_t value : description.specialization)
+			{
+				combine(value);
+			}
+			combine(description.vertexLayout);
+			combine(description.topology);
+			combine(description.polygonMode);
+			combine(description.cullMode);
+			combine(description.frontFace);
+			combine(description.samples);
+			combine(std::hash<float>()(description.minSampleShading));
+			combine(description.depthTest);
+			combine(description.depthWrite);
+			combine(description.depthCompareOp);
+			combine(description.blend);
+			combine(description.colorWriteMask);
+			combine(std::hash<VkPipelineLayout>()(description.layout));
+			combine(std::hash<VkRenderPass>()(description.renderPass));
+			combine(description.subpass);
+			return hash;
+		}
+	};
+
+	// What the device was created with
+	struct Features
+	{
+		bool extendedDynamicState = false; // VK_EXT_extended_dynamic_state
+		bool extendedDynamicState3 = false; // VK_EXT_extended_dynamic_state3, polygon mode, blend enable, write mask
+		bool graphicsPipelineLibrary = false; // VK_EXT_graphics_pipeline_library
+	};
+
+	struct Stats
+	{
+		uint64_t requests = 0;
+		uint64_t hits = 0;
+		uint32_t created = 0; // complete pipelines
+		uint32_t parts = 0; // pipeline library parts
+		double createTime = 0.0; // ms, every pipeline's creation summed (parts included), more than wall time on threads
+		double linkTime = 0.0; // ms, the share of createTime spent linking parts
+	};
+
+	// Returns the SPIR-V of a Description's shader path, compiled with its defines
+	using ShaderLoader = std::function<std::vector<char>(const std::string& path,
+	                                                     const std::vector<std::string>& defines)>;
+
+	// cacheData: what getCacheData() returned last launch, or empty
+	// The asynchronous workers leave one of threadCount to the thread that renders
+	// shaderLoader: reads the paths as SPIR-V files when empty
+	void create(VkDevice device, const std::vector<char>& cacheData, uint32_t threadCount, const Features& features,
+	            const ShaderLoader& shaderLoader = {})
+	{
+		this->device = device;
+		this->threadCount = threadCount;
+		this->features = features;
+		this->shaderLoader = shaderLoader ? shaderLoader : [](const std::string& path, const std::vector<std::string>&)
+		{
+			return TutUtils::readFile(path);
+		};
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = cacheData.size();
+		cacheInfo.pInitialData = cacheData.data();
+		// Data from another driver or device is ignored by the driver, not an error
+		if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline cache!");
+		}
+
+		if (features.extendedDynamicState)
+		{
+			loadFunction(cmdSetCullMode, "vkCmdSetCullModeEXT");
+			loadFunction(cmdSetFrontFace, "vkCmdSetFrontFaceEXT");
+			loadFunction(cmdSetPrimitiveTopology, "vkCmdSetPrimitiveTopologyEXT");
+			loadFunction(cmdSetDepthTestEnable, "vkCmdSetDepthTestEnableEXT");
+			loadFunction(cmdSetDepthWriteEnable, "vkCmdSetDepthWriteEnableEXT");
+			loadFunction(cmdSetDepthCompareOp, "vkCmdSetDepthCompareOpEXT");
+		}
+		if (features.extendedDynamicState3)
+		{
+			loadFunction(cmdSetPolygonMode, "vkCmdSetPolygonModeEXT");
+			loadFunction(cmdSetColorBlendEnable, "vkCmdSetColorBlendEnableEXT");
+			loadFunction(cmdSetColorWriteMask, "vkCmdSetColorWriteMaskEXT");
+		}
+
+		stopping = false;
+		for (uint32_t i = 0; i < std::max(threadCount, 2u) - 1; i++)
+		{
+			workers.emplace_back([this]() { work(); });
+		}
+	}
+
+	void destroy()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			queue.clear();
+		}
+		wakeUp.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+		for (const Result& result : finished)
+		{
+			vkDestroyPipeline(device, result.pipeline, nullptr);
+		}
+		finished.clear();
+		pending.clear();
+
+		for (const auto& entry : pipelines)
+		{
+			vkDestroyPipeline(device, entry.second, nullptr);
+		}
+		pipelines.clear();
+		for (auto& partPipelines : parts)
+		{
+			for (const auto& entry : partPipelines)
+			{
+				vkDestroyPipeline(device, entry.second, nullptr);
+			}
+			partPipelines.clear();
+		}
+		partCount = 0;
+		for (const auto& entry : shaderModules)
+		{
+			vkDestroyShaderModule(device, entry.second, nullptr);
+		}
+		shaderModules.clear();
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	}
+
+	// Returns the index for Description::vertexLayout, the same one for the same layout
+	uint32_t addVertexLayout(const std::vector<VkVertexInputBindingDescription>& bindings,
+	                         const std::vector<VkVertexInputAttributeDescription>& attributes)
+	{
+		for (uint32_t i = 0; i < vertexLayouts.size(); i++)
+		{
+			if (isSameLayout(vertexLayouts[i], bindings, attributes)) return i;
+		}
+		vertexLayouts.push_back({bindings, attributes});
+		return static_cast<uint32_t>(vertexLayouts.size() - 1);
+	}
+
+	VkPipeline get(const Description& description)
+	{
+		Description key = getKey(description);
+		stats.requests++;
+		auto found = pipelines.find(key);
+		if (found != pipelines.end())
+		{
+			stats.hits++;
+			return found->second;
+		}
+
+		// Queued by request(), creating it here as well would only make a duplicate
+		if (pending.count(key) != 0)
+		{
+			waitFor(key);
+			return pipelines.at(key);
+		}
+
+		Timing timing;
+		VkPipeline pipeline = createPipeline(makeJob(key), timing);
+		pipelines.emplace(key, pipeline);
+		addTiming(timing);
+		return pipeline;
+	}
+
+	// VK_NULL_HANDLE until a publish() after the workers created it
+	VkPipeline request(const Description& description)
+	{
+		Description key = getKey(description);
+		stats.requests++;
+		auto found = pipelines.find(key);
+		if (found != pipelines.end())
+		{
+			stats.hits++;
+			return found->second;
+		}
+
+		if (pending.insert(key).second)
+		{
+			Job job = makeJob(key);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back(std::move(job));
+			}
+			wakeUp.notify_one();
+		}
+		return VK_NULL_HANDLE;
+	}
+
+	// Hands the pipelines the workers finished to get() and request(), returns how many. Rethrows the first
+	// error of a worker once, the failed pipelines are no longer pending and the next request() tries again.
+	uint32_t publish()
+	{
+		std::vector<Result> results;
+		std::exception_ptr error;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			results.swap(finished);
+			error = workerError;
+			workerError = nullptr;
+		}
+
+		uint32_t published = 0;
+		for (const Result& result : results)
+		{
+			pending.erase(result.description);
+			if (result.pipeline == VK_NULL_HANDLE) continue; // failed
+			if (!pipelines.emplace(result.description, result.pipeline).second)
+			{
+				vkDestroyPipeline(device, result.pipeline, nullptr);
+				continue;
+			}
+			addTiming(result.timing);
+			published++;
+		}
+
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+		return published;
+	}
+
+	// Creates the pipelines that don't exist yet on the worker threads, returns the wall time in ms
+	double compile(const std::vector<Description>& descriptions)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		std::vector<Job> missing;
+		std::vector<Description> queued; // by request(), the workers finish them
+		for (const Description& description : descriptions)
+		{
+			Description key = getKey(description);
+			if (pending.count(key) != 0)
+			{
+				queued.push_back(key);
+			}
+			else if (pipelines.count(key) == 0 &&
+				std::find_if(missing.begin(), missing.end(), [&key](const Job& job)
+				{
+					return job.description == key;
+				}) == missing.end())
+			{
+				missing.push_back(makeJob(key));
+			}
+		}
+
+		// The map is only written once the threads are done
+		std::vector<VkPipeline> created(missing.size(), VK_NULL_HANDLE);
+		std::vector<Timing> timings(missing.size());
+		try
+		{
+			TutUtils::parallelFor(static_cast<uint32_t>(missing.size()), [&](uint32_t i)
+			{
+				created[i] = createPipeline(missing[i], timings[i]);
+			}, threadCount);
+		}
+		catch (...)
+		{
+			for (VkPipeline pipeline : created)
+			{
+				if (pipeline != VK_NULL_HANDLE) vkDestroyPipeline(device, pipeline, nullptr);
+			}
+			throw;
+		}
+
+		for (size_t i = 0; i < missing.size(); i++)
+		{
+			pipelines.emplace(missing[i].description, created[i]);
+			addTiming(timings[i]);
+		}
+		for (const Description& key : queued)
+		{
+			waitFor(key);
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	std::vector<char> getCacheData() const
+	{
+		size_t size = 0;
+		vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+		std::vector<char> data(size);
+		if (size > 0 && vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+		{
+			return {};
+		}
+		data.resize(size);
+		return data;
+	}
+
+	// Drops the shader's module and every pipeline and part made from it, the next get() or request() loads the
+	// shader again. Nothing may still use those pipelines. Returns how many pipelines were dropped.
+	uint32_t reloadShader(const std::string& path)
+	{
+		// Jobs in flight hold the old module
+		while (!pending.empty())
+		{
+			publish();
+			std::this_thread::yield();
+		}
+
+		uint32_t dropped = 0;
+		for (auto it = pipelines.begin(); it != pipelines.end();)
+		{
+			if (it->first.vertexShader == path || it->first.fragmentShader == path)
+			{
+				vkDestroyPipeline(device, it->second, nullptr);
+				it = pipelines.erase(it);
+				dropped++;
+			}
+			else
+			{
+				++it;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(partMutex);
+			for (auto& partPipelines : parts)
+			{
+				for (auto it = partPipelines.begin(); it != partPipelines.end();)
+				{
+					if (it->first.vertexShader == path || it->first.fragmentShader == path)
+					{
+						vkDestroyPipeline(device, it->second, nullptr);
+						it = partPipelines.erase(it);
+						partCount--;
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+		}
+
+		// Every variant of it
+		for (auto it = shaderModules.begin(); it != shaderModules.end();)
+		{
+			if (isModuleOf(it->first, path))
+			{
+				vkDestroyShaderModule(device, it->second, nullptr);
+				it = shaderModules.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+		return dropped;
+	}
+
+	bool usesShader(const std::string& path) const
+	{
+		return std::any_of(shaderModules.begin(), shaderModules.end(), [&path](const auto& entry)
+		{
+			return isModuleOf(entry.first, path);
+		});
+	}
+
+	// Every set of defines a module of the shader was compiled with, read back from the module keys
+	std::vector<std::vector<std::string>> getShaderDefines(const std::string& path) const
+	{
+		std::vector<std::vector<std::string>> defineSets;
+		for (const auto& entry : shaderModules)
+		{
+			if (!isModuleOf(entry.first, path)) continue;
+
+			std::vector<std::string> defines;
+			size_t start = path.size() + 1;
+			size_t end;
+			while ((end = entry.first.find('\n', start)) != std::string::npos)
+			{
+				defines.push_back(entry.first.substr(start, end - start));
+				start = end + 1;
+			}
+			defineSets.push_back(std::move(defines));
+		}
+		return defineSets;
+	}
+
+	// Sets the state that is dynamic on this device, after binding a pipeline of the description
+	void setDynamicState(VkCommandBuffer commandBuffer, const Description& description) const
+	{
+		if (features.extendedDynamicState)
+		{
+			cmdSetCullMode(commandBuffer, description.cullMode);
+			cmdSetFrontFace(commandBuffer, description.frontFace);
+			cmdSetPrimitiveTopology(commandBuffer, description.topology);
+			cmdSetDepthTestEnable(commandBuffer, description.depthTest);
+			cmdSetDepthWriteEnable(commandBuffer, description.depthWrite);
+			cmdSetDepthCompareOp(commandBuffer, description.depthCompareOp);
+		}
+		if (features.extendedDynamicState3)
+		{
+			cmdSetPolygonMode(commandBuffer, description.polygonMode);
+			cmdSetColorBlendEnable(commandBuffer, 0, 1, &description.blend);
+			cmdSetColorWriteMask(commandBuffer, 0, 1, &description.colorWriteMask);
+		}
+	}
+
+	Stats getStats() const
+	{
+		Stats result = stats;
+		std::lock_guard<std::mutex> lock(partMutex);
+		result.parts = partCount;
+		return result;
+	}
+	uint32_t getPipelineCount() const { return static_cast<uint32_t>(pipelines.size()); }
+	uint32_t getThreadCount() const { return threadCount; }
+	uint32_t getPendingCount() const { return static_cast<uint32_t>(pending.size()); }
+
+private:
+	struct VertexLayout
+	{
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+	};
+
+	// Everything creating the pipeline needs, so the threads never look into the maps the caller changes
+	struct Job
+	{
+		Description description;
+		VkShaderModule vertexModule = VK_NULL_HANDLE;
+		VkShaderModule fragmentModule = VK_NULL_HANDLE;
+		VertexLayout vertexLayout;
+	};
+
+	struct Timing
+	{
+		double create = 0.0; // ms
+		double link = 0.0; // ms
+	};
+
+	struct Result
+	{
+		Description description;
+		VkPipeline pipeline;
+		Timing timing;
+	};
+
+	static constexpr uint32_t PART_COUNT = 4;
+	static constexpr VkGraphicsPipelineLibraryFlagsEXT PART_FLAGS[PART_COUNT] = {
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+	};
+	static constexpr VkGraphicsPipelineLibraryFlagsEXT ALL_PARTS = PART_FLAGS[0] | PART_FLAGS[1] | PART_FLAGS[2] |
+		PART_FLAGS[3];
+
+	// The create info of a job's pipeline or of some of its parts, along with every struct it points to
+	class PipelineState
+	{
+	public:
+		explicit PipelineState(const Job& job)
+		{
+			const Description& description = job.description;
+
+			// Only the fragment stage is specialized, so the pre-rasterization part is shared by every variant. The
+			// data stays in the job's description
+			for (uint32_t i = 0; i < description.specialization.size(); i++)
+			{
+				specializationEntries.push_back({i, i * static_cast<uint32_t>(sizeof(uint32_t)), sizeof(uint32_t)});
+			}
+			specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+			specializationInfo.pMapEntries = specializationEntries.data();
+			specializationInfo.dataSize = description.specialization.size() * sizeof(uint32_t);
+			specializationInfo.pData = description.specialization.data();
+
+			VkPipelineShaderStageCreateInfo shaderStage{};
+			shaderStage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			shaderStage.pName = "main";
+			shaderStage.stage = VK_SHADER_STAGE_VERTEX_BIT;
+			shaderStage.module = job.vertexModule;
+			vertexStage = shaderStage;
+			shaderStage.pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+			shaderStage.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+			shaderStage.module = job.fragmentModule;
+			fragmentStage = shaderStage;
+
+			dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+
+			viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+			viewportState.viewportCount = 1;
+			viewportState.scissorCount = 1;
+
+			vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+			vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(job.vertexLayout.bindings.size());
+			vertexInputInfo.pVertexBindingDescriptions = job.vertexLayout.bindings.data();
+			vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(job.vertexLayout.attributes.size());
+			vertexInputInfo.pVertexAttributeDescriptions = job.vertexLayout.attributes.data();
+
+			// Input assembly
+			// VK_PRIMITIVE_TOPOLOGY_POINT_LIST: points from vertices
+			// VK_PRIMITIVE_TOPOLOGY_LINE_LIST: line from every 2 vertices without reuse
+			// VK_PRIMITIVE_TOPOLOGY_LINE_STRIP: the end vertex of every line is used as start vertex for the next line
+			// VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST: triangle from every 3 vertices without reuse
+			// VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP: the second and third vertex of every triangle are used as first two vertices of the next triangle
+			inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+			inputAssembly.topology = description.topology;
+			inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+			rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+			rasterizer.depthClampEnable = VK_FALSE;
+			// If true, fragments beyond near and far planes are clamped instead of discarded
+			rasterizer.rasterizerDiscardEnable = VK_FALSE; // If true, geometry never passes through rasterizer stage
+			// VK_POLYGON_MODE_FILL: fill the area of the polygon with fragments
+			// VK_POLYGON_MODE_LINE: polygon edges are drawn as lines
+			// VK_POLYGON_MODE_POINT: polygon vertices are drawn as points
+			rasterizer.polygonMode = description.polygonMode;
+			rasterizer.lineWidth = 1.0f;
+			rasterizer.cullMode = description.cullMode;
+			rasterizer.frontFace = description.frontFace;
+			rasterizer.depthBiasEnable = VK_FALSE;
+
+			// Both fragment parts carry it and they have to agree, getKey() already turned sample shading off for
+			// pipelines without a fragment shader
+			multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+			multisampling.rasterizationSamples = description.samples;
+			multisampling.sampleShadingEnable = description.minSampleShading > 0.0f;
+			multisampling.minSampleShading = description.minSampleShading;
+
+			depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+			depthStencil.depthTestEnable = description.depthTest;
+			depthStencil.depthWriteEnable = description.depthWrite;
+			depthStencil.depthCompareOp = description.depthCompareOp;
+			depthStencil.depthBoundsTestEnable = VK_FALSE;
+			depthStencil.minDepthBounds = 0.0f;
+			depthStencil.maxDepthBounds = 1.0f;
+			depthStencil.stencilTestEnable = VK_FALSE;
+
+			colorBlendAttachment.colorWriteMask = description.colorWriteMask;
+			colorBlendAttachment.blendEnable = description.blend;
+			// If true, then the new color is calculated using the following formula: finalColor.rgb = newAlpha * newColor + (1 - newAlpha) * oldColor;
+			colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+			colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+			colorBlending.logicOpEnable = VK_FALSE;
+			colorBlending.attachmentCount = 1;
+			colorBlending.pAttachments = &colorBlendAttachment;
+
+			layout = description.layout;
+			renderPass = description.renderPass;
+			subpass = description.subpass;
+			hasFragmentShader = !description.fragmentShader.empty();
+		}
+
+		PipelineState(const PipelineState&) = delete;
+		PipelineState& operator=(const PipelineState&) = delete;
+
+		// parts: ALL_PARTS for a complete pipeline, dynamicStates has to outlive the create info
+		VkGraphicsPipelineCreateInfo getCreateInfo(VkGraphicsPipelineLibraryFlagsEXT parts,
+		                                           const std::vector<VkDynamicState>& dynamicStates)
+		{
+			stages.clear();
+			if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+			{
+				stages.push_back(vertexStage);
+			}
+			if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) && hasFragmentShader)
+			{
+				stages.push_back(fragmentStage);
+			}
+			dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+			dynamicState.pDynamicStates = dynamicStates.data();
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.stageCount = static_cast<uint32_t>(stages.size());
+			pipelineInfo.pStages = stages.data();
+			pipelineInfo.pDynamicState = &dynamicState;
+			if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+			{
+				pipelineInfo.pVertexInputState = &vertexInputInfo;
+				pipelineInfo.pInputAssemblyState = &inputAssembly;
+			}
+			if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+			{
+				pipelineInfo.pViewportState = &viewportState;
+				pipelineInfo.pRasterizationState = &rasterizer;
+			}
+			if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT)
+			{
+				pipelineInfo.pDepthStencilState = &depthStencil;
+				pipelineInfo.pMultisampleState = &multisampling;
+			}
+			if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+			{
+				pipelineInfo.pColorBlendState = &colorBlending;
+				pipelineInfo.pMultisampleState = &multisampling;
+			}
+			if (parts & (VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT |
+				VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))
+			{
+				pipelineInfo.layout = layout;
+			}
+			if (parts & ~VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT)
+			{
+				pipelineInfo.renderPass = renderPass;
+				pipelineInfo.subpass = subpass; // Index of subpass in render pass where pipeline will be used
+			}
+			pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+			pipelineInfo.basePipelineIndex = -1;
+			return pipelineInfo;
+		}
+
+	private:
+		std::vector<VkSpecializationMapEntry> specializationEntries;
+		VkSpecializationInfo specializationInfo{};
+		VkPipelineShaderStageCreateInfo vertexStage{};
+		VkPipelineShaderStageCreateInfo fragmentStage{};
+		std::vector<VkPipelineShaderStageCreateInfo> stages;
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		VkPipelineViewportStateCreateInfo viewportState{};
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		uint32_t subpass = 0;
+		bool hasFragmentShader = false;
+	};
+
+	template <typename T>
+	void loadFunction(T& function, const char* name)
+	{
+		function = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+		if (function == nullptr)
+		{
+			throw std::runtime_error("failed to load device function!");
+		}
+	}
+
+	// Publishes until the workers are done with the key, it is in the map after unless they failed and this threw
+	void waitFor(const Description& key)
+	{
+		while (pending.count(key) != 0)
+		{
+			publish();
+			std::this_thread::yield();
+		}
+	}
+
+	void addTiming(const Timing& timing)
+	{
+		stats.created++;
+		stats.createTime += timing.create;
+		stats.linkTime += timing.link;
+	}
+
+	// The description with what is dynamic on this device cleared, pipelines are keyed and created by it
+	Description getKey(const Description& description) const
+	{
+		Description key = description;
+		if (key.fragmentShader.empty())
+		{
+			key.minSampleShading = 0.0f;
+		}
+		if (features.extendedDynamicState)
+		{
+			key.topology = getTopologyClass(key.topology);
+			key.cullMode = VK_CULL_MODE_NONE;
+			key.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+			key.depthTest = VK_FALSE;
+			key.depthWrite = VK_FALSE;
+			key.depthCompareOp = VK_COMPARE_OP_NEVER;
+		}
+		if (features.extendedDynamicState3)
+		{
+			key.polygonMode = VK_POLYGON_MODE_FILL;
+			key.blend = VK_FALSE;
+			key.colorWriteMask = 0;
+		}
+		return key;
+	}
+
+	// Dynamic topology may only switch within the class the pipeline was created with
+	static VkPrimitiveTopology getTopologyClass(VkPrimitiveTopology topology)
+	{
+		switch (topology)
+		{
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+		case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+			return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP:
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN:
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST_WITH_ADJACENCY:
+		case VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP_WITH_ADJACENCY:
+			return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		default:
+			return topology;
+		}
+	}
+
+	// Only what a part's state depends on, so every pipeline sharing it finds the same part
+	static Description getPartKey(const Description& description, uint32_t part)
+	{
+		Description key;
+		switch (part)
+		{
+		case 0: // vertex input
+			key.vertexLayout = description.vertexLayout;
+			key.topology = description.topology;
+			return key;
+		case 1: // pre-rasterization
+			key.vertexShader = description.vertexShader;
+			key.defines = description.defines;
+			key.polygonMode = description.polygonMode;
+			key.cullMode = description.cullMode;
+			key.frontFace = description.frontFace;
+			key.layout = description.layout;
+			break;
+		case 2: // fragment shader
+			key.fragmentShader = description.fragmentShader;
+			key.defines = description.defines;
+			key.specialization = description.specialization;
+			key.samples = description.samples;
+			key.minSampleShading = description.minSampleShading;
+			key.depthTest = description.depthTest;
+			key.depthWrite = description.depthWrite;
+			key.depthCompareOp = description.depthCompareOp;
+			key.layout = description.layout;
+			break;
+		default: // fragment output
+			key.samples = description.samples;
+			key.minSampleShading = description.minSampleShading;
+			key.blend = description.blend;
+			key.colorWriteMask = description.colorWriteMask;
+			break;
+		}
+		key.renderPass = description.renderPass;
+		key.subpass = description.subpass;
+		return key;
+	}
+
+	// The dynamic states belonging to the parts
+	std::vector<VkDynamicState> getDynamicStates(VkGraphicsPipelineLibraryFlagsEXT parts) const
+	{
+		std::vector<VkDynamicState> dynamicStates;
+		if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) && features.extendedDynamicState)
+		{
+			dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT);
+		}
+		if (parts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT)
+		{
+			dynamicStates.push_back(VK_DYNAMIC_STATE_VIEWPORT);
+			dynamicStates.push_back(VK_DYNAMIC_STATE_SCISSOR);
+			if (features.extendedDynamicState)
+			{
+				dynamicStates.push_back(VK_DYNAMIC_STATE_CULL_MODE_EXT);
+				dynamicStates.push_back(VK_DYNAMIC_STATE_FRONT_FACE_EXT);
+			}
+			if (features.extendedDynamicState3)
+			{
+				dynamicStates.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+			}
+		}
+		if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT) && features.extendedDynamicState)
+		{
+			dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT);
+			dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT);
+			dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT);
+		}
+		if ((parts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT) && features.extendedDynamicState3)
+		{
+			dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+			dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+		}
+		return dynamicStates;
+	}
+
+	static bool isSameLayout(const VertexLayout& layout,
+	                         const std::vector<VkVertexInputBindingDescription>& bindings,
+	                         const std::vector<VkVertexInputAttributeDescription>& attributes)
+	{
+		if (layout.bindings.size() != bindings.size() || layout.attributes.size() != attributes.size()) return false;
+		for (size_t i = 0; i < bindings.size(); i++)
+		{
+			const VkVertexInputBindingDescription& a = layout.bindings[i];
+			const VkVertexInputBindingDescription& b = bindings[i];
+			if (a.binding != b.binding || a.stride != b.stride || a.inputRate != b.inputRate) return false;
+		}
+		for (size_t i = 0; i < attributes.size(); i++)
+		{
+			const VkVertexInputAttributeDescription& a = layout.attributes[i];
+			const VkVertexInputAttributeDescription& b = attributes[i];
+			if (a.location != b.location || a.binding != b.binding || a.format != b.format || a.offset != b.offset)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	Job makeJob(const Description& description)
+	{
+		loadShaders(description);
+		Job job;
+		job.description = description;
+		job.vertexModule = shaderModules.at(getModuleKey(description.vertexShader, description.defines));
+		if (!description.fragmentShader.empty())
+		{
+			job.fragmentModule = shaderModules.at(getModuleKey(description.fragmentShader, description.defines));
+		}
+		job.vertexLayout = vertexLayouts.at(description.vertexLayout);
+		return job;
+	}
+
+	void loadShaders(const Description& description)
+	{
+		for (const std::string* path : {&description.vertexShader, &description.fragmentShader})
+		{
+			if (path->empty()) continue;
+			std::string key = getModuleKey(*path, description.defines);
+			if (shaderModules.count(key) > 0) continue;
+
+			auto code = shaderLoader(*path, description.defines);
+			VkShaderModuleCreateInfo createInfo{};
+			createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			createInfo.codeSize = code.size();
+			createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+			VkShaderModule shaderModule;
+			if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create shader module!");
+			}
+			shaderModules.emplace(key, shaderModule);
+		}
+	}
+
+	// The path, then every define, each ended by a newline
+	static std::string getModuleKey(const std::string& path, const std::vector<std::string>& defines)
+	{
+		std::string key = path + '\n';
+		for (const std::string& define : defines)
+		{
+			key += define + '\n';
+		}
+		return key;
+	}
+
+	static bool isModuleOf(const std::string& key, const std::string& path)
+	{
+		return key.size() > path.size() && key.compare(0, path.size(), path) == 0 && key[path.size()] == '\n';
+	}
+
+	// Safe on any thread
+	VkPipeline createPipeline(const Job& job, Timing& timing)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		VkPipeline pipeline;
+		if (features.graphicsPipelineLibrary)
+		{
+			std::array<VkPipeline, PART_COUNT> libraries;
+			for (uint32_t part = 0; part < PART_COUNT; part++)
+			{
+				libraries[part] = getPart(job, part);
+			}
+
+			VkPipelineLibraryCreateInfoKHR libraryInfo{};
+			libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+			libraryInfo.libraryCount = static_cast<uint32_t>(libraries.size());
+			libraryInfo.pLibraries = libraries.data();
+
+			VkGraphicsPipelineCreateInfo pipelineInfo{};
+			pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+			pipelineInfo.pNext = &libraryInfo;
+			pipelineInfo.layout = job.description.layout;
+			pipelineInfo.basePipelineIndex = -1;
+
+			auto linkStart = std::chrono::high_resolution_clock::now();
+			if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to link graphics pipeline!");
+			}
+			auto linkEnd = std::chrono::high_resolution_clock::now();
+			timing.link = std::chrono::duration<double, std::milli>(linkEnd - linkStart).count();
+		}
+		else
+		{
+			PipelineState state(job);
+			std::vector<VkDynamicState> dynamicStates = getDynamicStates(ALL_PARTS);
+			VkGraphicsPipelineCreateInfo pipelineInfo = state.getCreateInfo(ALL_PARTS, dynamicStates);
+			if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+			{
+				throw std::runtime_error("failed to create graphics pipeline!");
+			}
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		timing.create = std::chrono::duration<double, std::milli>(end - start).count();
+		return pipeline;
+	}
+
+	// Safe on any thread. A part is created outside the lock, with VK_NULL_HANDLE in its slot meanwhile so the
+	// threads that need the same one wait for it instead of creating it again.
+	VkPipeline getPart(const Job& job, uint32_t part)
+	{
+		Description key = getPartKey(job.description, part);
+		{
+			std::unique_lock<std::mutex> lock(partMutex);
+			auto found = parts[part].find(key);
+			partReady.wait(lock, [&]()
+			{
+				found = parts[part].find(key);
+				return found == parts[part].end() || found->second != VK_NULL_HANDLE;
+			});
+			if (found != parts[part].end())
+			{
+				return found->second;
+			}
+			parts[part].emplace(key, VK_NULL_HANDLE);
+		}
+
+		PipelineState state(job);
+		std::vector<VkDynamicState> dynamicStates = getDynamicStates(PART_FLAGS[part]);
+		VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+		libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+		libraryInfo.flags = PART_FLAGS[part];
+		VkGraphicsPipelineCreateInfo pipelineInfo = state.getCreateInfo(PART_FLAGS[part], dynamicStates);
+		pipelineInfo.pNext = &libraryInfo;
+		pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+
+		VkPipeline library;
+		VkResult result = vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &library);
+
+		std::lock_guard<std::mutex> lock(partMutex);
+		if (result != VK_SUCCESS)
+		{
+			// The waiting threads try for themselves
+			parts[part].erase(key);
+			partReady.notify_all();
+			throw std::runtime_error("failed to create graphics pipeline library!");
+		}
+		parts[part][key] = library;
+		partCount++;
+		partReady.notify_all();
+		return library;
+	}
+
+	void work()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (stopping) return;
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+
+			Result result{job.description, VK_NULL_HANDLE, {}};
+			try
+			{
+				result.pipeline = createPipeline(job, result.timing);
+			}
+			catch (...)
+			{
+				// Rethrown by the next publish(), the empty result takes the description off pending
+				std::lock_guard<std::mutex> lock(mutex);
+				if (!workerError) workerError = std::current_exception();
+				finished.push_back(std::move(result));
+				continue;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.push_back(std::move(result));
+		}
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	uint32_t threadCount = 1;
+	Features features;
+	ShaderLoader shaderLoader;
+	PFN_vkCmdSetCullModeEXT cmdSetCullMode = nullptr;
+	PFN_vkCmdSetFrontFaceEXT cmdSetFrontFace = nullptr;
+	PFN_vkCmdSetPrimitiveTopologyEXT cmdSetPrimitiveTopology = nullptr;
+	PFN_vkCmdSetDepthTestEnableEXT cmdSetDepthTestEnable = nullptr;
+	PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+	PFN_vkCmdSetDepthCompareOpEXT cmdSetDepthCompareOp = nullptr;
+	PFN_vkCmdSetPolygonModeEXT cmdSetPolygonMode = nullptr;
+	PFN_vkCmdSetColorBlendEnableEXT cmdSetColorBlendEnable = nullptr;
+	PFN_vkCmdSetColorWriteMaskEXT cmdSetColorWriteMask = nullptr;
+
+	// caller's thread only
+	std::vector<VertexLayout> vertexLayouts;
+	std::unordered_map<std::string, VkShaderModule> shaderModules; // by getModuleKey()
+	std::unordered_map<Description, VkPipeline, DescriptionHash> pipelines;
+	std::unordered_set<Description, DescriptionHash> pending; // requested, not published yet
+	Stats stats;
+
+	// shared with the workers
+	std::vector<std::thread> workers;
+	std::deque<Job> queue;
+	std::vector<Result> finished;
+	std::exception_ptr workerError;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+
+	// shared by every thread creating pipelines
+	std::array<std::unordered_map<Description, VkPipeline, DescriptionHash>, PART_COUNT> parts;
+	uint32_t partCount = 0;
+	mutable std::mutex partMutex;
+	std::condition_variable partReady;
+};
+
+#endif /* PipelineLibrary_h */
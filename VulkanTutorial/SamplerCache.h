@@ -0,0 +1,135 @@
+//
+//  SamplerCache.h
+//  VulkanTutorial
+//
+
+#ifndef SamplerCache_h
+#define SamplerCache_h
+
+#include <vulkan/vulkan.h>
+#include <unordered_map>
+#include <functional>
+#include <stdexcept>
+
+// Sampler cache
+// Samplers are tiny, immutable and interchangeable, but every vkCreateSampler counts against
+// maxSamplerAllocationCount (as low as 4000). get() hashes the whole VkSamplerCreateInfo and hands out the same
+// VkSampler for equal ones, so materials can ask for the sampler they want without tracking who owns it.
+// Samplers live until destroy(), which makes them safe to use as immutable samplers in descriptor set layouts
+// and to share between frames in flight without any deferred deletion.
+// pNext chains (reduction mode, YCbCr conversion) are not part of the key and are rejected.
+class SamplerCache
+{
+public:
+	struct Stats
+	{
+		uint64_t requests = 0;
+		uint64_t hits = 0;
+
+		double getHitRate() const { return requests > 0 ? static_cast<double>(hits) / requests : 0.0; }
+	};
+
+	void create(VkDevice device, uint32_t maxSamplers)
+	{
+		this->device = device;
+		this->maxSamplers = maxSamplers;
+	}
+
+	void destroy()
+	{
+		for (const auto& entry : samplers)
+		{
+			vkDestroySampler(device, entry.second, nullptr);
+		}
+		samplers.clear();
+	}
+
+	VkSampler get(const VkSamplerCreateInfo& createInfo)
+	{
+		if (createInfo.pNext != nullptr)
+		{
+			throw std::runtime_error("sampler cache can't key pNext chains!");
+		}
+
+		stats.requests++;
+		Key key{createInfo};
+		auto found = samplers.find(key);
+		if (found != samplers.end())
+		{
+			stats.hits++;
+			return found->second;
+		}
+
+		if (samplers.size() >= maxSamplers)
+		{
+			throw std::runtime_error("sampler cache is over maxSamplerAllocationCount!");
+		}
+		VkSampler sampler;
+		if (vkCreateSampler(device, &createInfo, nullptr, &sampler) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create texture sampler!");
+		}
+		samplers.emplace(key, sampler);
+		return sampler;
+	}
+
+	uint32_t getSamplerCount() const { return static_cast<uint32_t>(samplers.size()); }
+	const Stats& getStats() const { return stats; }
+
+private:
+	// Every field but sType and pNext, floats compared by value so 0.0f and -0.0f are one sampler
+	struct Key
+	{
+		VkSamplerCreateInfo info;
+
+		bool operator==(const Key& other) const
+		{
+			const VkSamplerCreateInfo& a = info;
+			const VkSamplerCreateInfo& b = other.info;
+			return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter &&
+				a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU &&
+				a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW &&
+				a.mipLodBias == b.mipLodBias && a.anisotropyEnable == b.anisotropyEnable &&
+				a.maxAnisotropy == b.maxAnisotropy && a.compareEnable == b.compareEnable &&
+				a.compareOp == b.compareOp && a.minLod == b.minLod && a.maxLod == b.maxLod &&
+				a.borderColor == b.borderColor && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+		}
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			const VkSamplerCreateInfo& info = key.info;
+			size_t hash = 0;
+			auto combine = [&hash](size_t value)
+			{
+				hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+			};
+			combine(info.flags);
+			combine(info.magFilter);
+			combine(info.minFilter);
+			combine(info.mipmapMode);
+			combine(info.addressModeU);
+			combine(info.addressModeV);
+			combine(info.addressModeW);
+			combine(std::hash<float>()(info.mipLodBias));
+			combine(info.anisotropyEnable);
+			combine(std::hash<float>()(info.maxAnisotropy));
+			combine(info.compareEnable);
+			combine(info.compareOp);
+			combine(std::hash<float>()(info.minLod));
+			combine(std::hash<float>()(info.maxLod));
+			combine(info.borderColor);
+			combine(info.unnormalizedCoordinates);
+			return hash;
+		}
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t maxSamplers = 0;
+	std::unordered_map<Key, VkSampler, KeyHash> samplers;
+	Stats stats;
+};
+
+#endif /* SamplerCache_h */
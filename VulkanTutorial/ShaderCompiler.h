@@ -0,0 +1,316 @@
+//
+//  ShaderCompiler.h
+//  VulkanTutorial
+//
+
+#ifndef ShaderCompiler_h
+#define ShaderCompiler_h
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__has_include)
+#if __has_include(<shaderc/shaderc.h>)
+#include <shaderc/shaderc.h>
+#define SHADERC_AVAILABLE
+#endif
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "Utils.h"
+
+// Reports files that changed since the last poll()
+// On Linux the directories of the watched files are watched with inotify, so a poll is one read that usually returns
+// nothing. Elsewhere every watched file's size and write time are compared, which is cheap for a handful of files.
+class FileWatcher
+{
+public:
+	void create()
+	{
+#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (inotifyFd < 0)
+		{
+			throw std::runtime_error("failed to initialize inotify!");
+		}
+#endif
+	}
+
+	void destroy()
+	{
+#ifdef __linux__
+		if (inotifyFd >= 0) close(inotifyFd);
+		inotifyFd = -1;
+		directories.clear();
+#endif
+		files.clear();
+	}
+
+	void watch(const std::string& path)
+	{
+		std::string file = std::filesystem::path(path).generic_string();
+		if (files.count(file) > 0) return;
+		files.emplace(file, TutUtils::getFileStamp(file));
+#ifdef __linux__
+		// Editors either write the file in place or write a new one and rename it over
+		std::string directory = std::filesystem::path(file).parent_path().generic_string();
+		if (directory.empty()) directory = ".";
+		int wd = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd >= 0)
+		{
+			directories.emplace(wd, directory);
+		}
+#endif
+	}
+
+	// Every changed file once, however many events it got
+	std::vector<std::string> poll()
+	{
+		std::vector<std::string> changed;
+#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* event = buffer; event < buffer + length;)
+			{
+				const inotify_event* info = reinterpret_cast<const inotify_event*>(event);
+				event += sizeof(inotify_event) + info->len;
+				auto directory = directories.find(info->wd);
+				if (info->len == 0 || directory == directories.end()) continue;
+
+				std::string file = (std::filesystem::path(directory->second) / info->name).generic_string();
+				if (directory->second == ".") file = info->name;
+				if (files.count(file) > 0 && std::find(changed.begin(), changed.end(), file) == changed.end())
+				{
+					changed.push_back(file);
+				}
+			}
+		}
+		for (const std::string& file : changed)
+		{
+			files[file] = TutUtils::getFileStamp(file);
+		}
+#else
+		for (auto& entry : files)
+		{
+			uint64_t stamp = TutUtils::getFileStamp(entry.first);
+			// 0 while an editor has the file moved away, it comes back with a new stamp
+			if (stamp != 0 && stamp != entry.second)
+			{
+				entry.second = stamp;
+				changed.push_back(entry.first);
+			}
+		}
+#endif
+		return changed;
+	}
+
+private:
+#ifdef __linux__
+	int inotifyFd = -1;
+	std::unordered_map<int, std::string> directories; // by watch descriptor
+#endif
+	std::unordered_map<std::string, uint64_t> files; // stamp by path
+};
+
+// Runtime GLSL to SPIR-V compilation
+// GLSL sources (.vert, .frag, .comp) are compiled with shaderc, the library the SDK's glslc is built on, and the
+// SPIR-V is kept in cacheDirectory as <hash>.spv. The hash covers the source text, the stage, the defines and
+// CACHE_VERSION, so an unchanged shader costs reading the source and one cache file, and editing a shader back to an
+// earlier version finds that version's SPIR-V again. Old entries are never evicted, deleting the directory is safe.
+// Paths ending in .spv are read as they are. Sources can be watched, getChangedSources() then tells which were saved
+// since the last call. Built without the shaderc headers only the cache is there, isAvailable() tells the app to
+// use the offline compiled files from compile_shader.bat instead. Not thread safe.
+class ShaderCompiler
+{
+public:
+	struct Stats
+	{
+		uint32_t requests = 0; // sources loaded
+		uint32_t cacheHits = 0;
+		uint32_t compiled = 0;
+		double compileTime = 0.0; // ms
+	};
+
+	void create(const std::string& cacheDirectory, bool watchSources)
+	{
+		this->cacheDirectory = cacheDirectory;
+		this->watchSources = watchSources;
+		std::error_code error;
+		std::filesystem::create_directories(cacheDirectory, error);
+		if (watchSources)
+		{
+			watcher.create();
+		}
+#ifdef SHADERC_AVAILABLE
+		compiler = shaderc_compiler_initialize();
+		if (compiler == nullptr)
+		{
+			throw std::runtime_error("failed to initialize shader compiler!");
+		}
+#endif
+	}
+
+	void destroy()
+	{
+#ifdef SHADERC_AVAILABLE
+		if (compiler != nullptr) shaderc_compiler_release(compiler);
+		compiler = nullptr;
+#endif
+		watcher.destroy();
+	}
+
+	static bool isAvailable()
+	{
+#ifdef SHADERC_AVAILABLE
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	// SPIR-V of the file at path. defines are "NAME" or "NAME=VALUE", for sources only.
+	// Throws on compile errors after printing the compiler's messages.
+	std::vector<char> load(const std::string& path, const std::vector<std::string>& defines = {})
+	{
+		if (std::filesystem::path(path).extension() == ".spv")
+		{
+			return TutUtils::readFile(path);
+		}
+
+		stats.requests++;
+		if (watchSources)
+		{
+			watcher.watch(path);
+		}
+		std::vector<char> source = TutUtils::readFile(path);
+		std::string cachePath = getCachePath(path, source, defines);
+		std::vector<char> code;
+		if (readCache(cachePath, code))
+		{
+			stats.cacheHits++;
+			return code;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		code = compile(path, source, defines);
+		auto end = std::chrono::high_resolution_clock::now();
+		stats.compiled++;
+		stats.compileTime += std::chrono::duration<double, std::milli>(end - start).count();
+
+		// Written aside and renamed, so a crash never leaves a truncated entry behind
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream file(tempPath, std::ios::binary);
+			file.write(code.data(), static_cast<std::streamsize>(code.size()));
+		}
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		return code;
+	}
+
+	// Watched sources saved since the last call
+	std::vector<std::string> getChangedSources()
+	{
+		if (!watchSources) return {};
+		return watcher.poll();
+	}
+
+	const Stats& getStats() const { return stats; }
+
+private:
+	// Bump when the compile options change, the cached SPIR-V no longer matches them
+	static constexpr uint32_t CACHE_VERSION = 1;
+
+	std::string getCachePath(const std::string& path, const std::vector<char>& source,
+	                         const std::vector<std::string>& defines) const
+	{
+		uint64_t hash = TutUtils::hashBytes(&CACHE_VERSION, sizeof(CACHE_VERSION));
+		std::string extension = std::filesystem::path(path).extension().string();
+		hash = TutUtils::hashBytes(extension.data(), extension.size(), hash);
+		hash = TutUtils::hashBytes(source.data(), source.size(), hash);
+		for (const std::string& define : defines)
+		{
+			// The terminator keeps {"AB"} and {"A", "B"} apart
+			hash = TutUtils::hashBytes(define.c_str(), define.size() + 1, hash);
+		}
+
+		char name[32];
+		std::snprintf(name, sizeof(name), "%016llx.spv", static_cast<unsigned long long>(hash));
+		return (std::filesystem::path(cacheDirectory) / name).string();
+	}
+
+	static bool readCache(const std::string& cachePath, std::vector<char>& code)
+	{
+		if (TutUtils::getFileStamp(cachePath) == 0) return false;
+		code = TutUtils::readFile(cachePath);
+		// Anything but a whole SPIR-V module is compiled again and overwritten
+		const uint32_t magic = 0x07230203;
+		return code.size() >= 20 && code.size() % 4 == 0 && std::memcmp(code.data(), &magic, 4) == 0;
+	}
+
+	std::vector<char> compile(const std::string& path, const std::vector<char>& source,
+	                          const std::vector<std::string>& defines)
+	{
+#ifdef SHADERC_AVAILABLE
+		std::string extension = std::filesystem::path(path).extension().string();
+		shaderc_shader_kind kind;
+		if (extension == ".vert") kind = shaderc_vertex_shader;
+		else if (extension == ".frag") kind = shaderc_fragment_shader;
+		else if (extension == ".comp") kind = shaderc_compute_shader;
+		else throw std::runtime_error("unknown shader stage!");
+
+		shaderc_compile_options_t options = shaderc_compile_options_initialize();
+		shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+		for (const std::string& define : defines)
+		{
+			size_t equals = define.find('=');
+			size_t nameLength = equals == std::string::npos ? define.size() : equals;
+			const char* value = equals == std::string::npos ? "" : define.c_str() + equals + 1;
+			shaderc_compile_options_add_macro_definition(options, define.c_str(), nameLength, value,
+			                                             std::strlen(value));
+		}
+
+		shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, source.data(), source.size(), kind,
+		                                                               path.c_str(), "main", options);
+		shaderc_compile_options_release(options);
+		if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success)
+		{
+			std::cerr << shaderc_result_get_error_message(result);
+			shaderc_result_release(result);
+			throw std::runtime_error("failed to compile shader!");
+		}
+
+		const char* bytes = shaderc_result_get_bytes(result);
+		std::vector<char> code(bytes, bytes + shaderc_result_get_length(result));
+		shaderc_result_release(result);
+		return code;
+#else
+		throw std::runtime_error("failed to compile shader, built without shaderc!");
+#endif
+	}
+
+	std::string cacheDirectory;
+	bool watchSources = false;
+	FileWatcher watcher;
+	Stats stats;
+#ifdef SHADERC_AVAILABLE
+	shaderc_compiler_t compiler = nullptr;
+#endif
+};
+
+#endif /* ShaderCompiler_h */
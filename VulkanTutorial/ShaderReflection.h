@@ -0,0 +1,692 @@
+//
+//  ShaderReflection.h
+//  VulkanTutorial
+//
+
+#ifndef ShaderReflection_h
+#define ShaderReflection_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "Utils.h"
+
+// SPIR-V reflection
+// Reads what a shader module declares straight from its words: descriptor bindings, the push constant block and the
+// vertex inputs. Only the declarations at the start of a module are walked, parsing stops at the first function, so a
+// module costs a few microseconds. reflect() keeps every module it parsed by the hash of its code, and
+// getPipelineLayout() keeps pipeline layouts by their set layouts and push constant range, so asking again for the
+// same shaders or the same layout is a lookup. Set layouts go through DescriptorLayoutCache as usual.
+// What a shader can't say is left to the caller: whether a buffer is bound with a dynamic offset, immutable samplers,
+// and how vertex inputs are split between bindings.
+class ShaderReflection
+{
+public:
+	struct Binding
+	{
+		uint32_t set;
+		uint32_t binding;
+		VkDescriptorType type;
+		uint32_t count; // 0 for runtime arrays, the caller picks the size
+	};
+
+	struct Input
+	{
+		uint32_t location;
+		VkFormat format;
+		uint32_t size; // bytes
+	};
+
+	struct Module
+	{
+		VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+		std::vector<Binding> bindings; // by set, then binding
+		uint32_t pushConstantOffset = 0;
+		uint32_t pushConstantSize = 0; // 0 without a push constant block
+		std::vector<Input> inputs; // vertex shaders only, by location
+	};
+
+	struct Stats
+	{
+		uint32_t requests = 0;
+		uint32_t parsed = 0;
+		double parseTime = 0.0; // ms
+	};
+
+	void create(VkDevice device)
+	{
+		this->device = device;
+	}
+
+	void destroy()
+	{
+		for (const auto& entry : pipelineLayouts)
+		{
+			vkDestroyPipelineLayout(device, entry.second, nullptr);
+		}
+		pipelineLayouts.clear();
+		modules.clear();
+	}
+
+	// Parsed once per distinct code, the reference stays valid until destroy()
+	const Module& reflect(const std::vector<char>& code)
+	{
+		stats.requests++;
+		uint64_t hash = TutUtils::hashBytes(code.data(), code.size());
+		auto found = modules.find(hash);
+		if (found != modules.end())
+		{
+			return found->second;
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		Module module = parse(code.data(), code.size());
+		auto end = std::chrono::high_resolution_clock::now();
+		stats.parsed++;
+		stats.parseTime += std::chrono::duration<double, std::milli>(end - start).count();
+		return modules.emplace(hash, std::move(module)).first->second;
+	}
+
+	// Throws on anything that isn't a SPIR-V module
+	static Module parse(const void* code, size_t size)
+	{
+		const uint32_t* words = static_cast<const uint32_t*>(code);
+		size_t wordCount = size / sizeof(uint32_t);
+		if (wordCount < 5 || words[0] != SPIRV_MAGIC)
+		{
+			throw std::runtime_error("failed to reflect shader, not SPIR-V!");
+		}
+		// Optimizers leave gaps in the ids, but never that many
+		if (words[3] > 4 * wordCount)
+		{
+			throw std::runtime_error("failed to reflect shader, id bound out of range!");
+		}
+
+		// Everything the declarations say about an id, the bound in the header covers every id
+		std::vector<Id> ids(words[3]);
+		Module module;
+		bool entryPoint = false;
+		for (size_t i = 5; i < wordCount;)
+		{
+			uint32_t opcode = words[i] & 0xffff;
+			uint32_t length = words[i] >> 16;
+			if (length < getMinLength(opcode) || i + length > wordCount)
+			{
+				throw std::runtime_error("failed to reflect shader, truncated instruction!");
+			}
+			const uint32_t* operands = words + i + 1;
+			i += length;
+
+			switch (opcode)
+			{
+			case OP_ENTRY_POINT:
+				if (!entryPoint)
+				{
+					module.stage = getStage(operands[0]);
+					entryPoint = true;
+				}
+				break;
+			case OP_DECORATE:
+				decorate(ids, operands[0], operands[1], length > 3 ? operands[2] : 0);
+				break;
+			case OP_MEMBER_DECORATE:
+				if (operands[0] < ids.size() && operands[1] < wordCount && length > 4 &&
+					(operands[2] == DECORATION_OFFSET || operands[2] == DECORATION_MATRIX_STRIDE))
+				{
+					Id& type = ids[operands[0]];
+					if (type.members.size() <= operands[1])
+					{
+						type.members.resize(operands[1] + 1);
+					}
+					(operands[2] == DECORATION_OFFSET ? type.members[operands[1]].offset :
+						type.members[operands[1]].matrixStride) = operands[3];
+				}
+				break;
+			case OP_TYPE_BOOL:
+			case OP_TYPE_INT:
+			case OP_TYPE_FLOAT:
+			case OP_TYPE_VECTOR:
+			case OP_TYPE_MATRIX:
+			case OP_TYPE_IMAGE:
+			case OP_TYPE_SAMPLER:
+			case OP_TYPE_SAMPLED_IMAGE:
+			case OP_TYPE_ARRAY:
+			case OP_TYPE_RUNTIME_ARRAY:
+			case OP_TYPE_STRUCT:
+			case OP_TYPE_POINTER:
+				declareType(ids, opcode, operands, length - 1);
+				break;
+			case OP_CONSTANT:
+			case OP_SPEC_CONSTANT:
+				// Array lengths, only the low word matters, spec constants count with their default
+				getId(ids, operands[1]).opcode = opcode;
+				getId(ids, operands[1]).value = operands[2];
+				break;
+			case OP_VARIABLE:
+				getId(ids, operands[1]).opcode = opcode;
+				getId(ids, operands[1]).operands = {operands[0], operands[2]}; // pointer type, storage class
+				break;
+			default:
+				break;
+			}
+
+			// Declarations come before every function
+			if (opcode == OP_FUNCTION) break;
+		}
+		if (!entryPoint)
+		{
+			throw std::runtime_error("failed to reflect shader, no entry point!");
+		}
+
+		for (const Id& variable : ids)
+		{
+			if (variable.opcode != OP_VARIABLE) continue;
+
+			uint32_t storageClass = variable.operands[1];
+			uint32_t type = ids.at(variable.operands[0]).operands.at(1); // what the pointer points to
+			switch (storageClass)
+			{
+			case STORAGE_UNIFORM_CONSTANT:
+			case STORAGE_UNIFORM:
+			case STORAGE_STORAGE_BUFFER:
+				module.bindings.push_back(getBinding(ids, variable, storageClass, type));
+				break;
+			case STORAGE_PUSH_CONSTANT:
+				getMemberRange(ids, ids.at(type), module.pushConstantOffset, module.pushConstantSize);
+				break;
+			case STORAGE_INPUT:
+				// Built-ins have no location
+				if (module.stage == VK_SHADER_STAGE_VERTEX_BIT && variable.hasLocation)
+				{
+					addInputs(ids, type, variable.location, module.inputs);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		std::sort(module.bindings.begin(), module.bindings.end(), [](const Binding& a, const Binding& b)
+		{
+			return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+		});
+		std::sort(module.inputs.begin(), module.inputs.end(), [](const Input& a, const Input& b)
+		{
+			return a.location < b.location;
+		});
+		return module;
+	}
+
+	// One more than the highest set any of the modules uses
+	static uint32_t getSetCount(const std::vector<const Module*>& modules)
+	{
+		uint32_t count = 0;
+		for (const Module* module : modules)
+		{
+			for (const Binding& binding : module->bindings)
+			{
+				count = std::max(count, binding.set + 1);
+			}
+		}
+		return count;
+	}
+
+	// The bindings of set as all of the modules see it, by binding, visible to every stage that declares them
+	static std::vector<VkDescriptorSetLayoutBinding> getSetBindings(const std::vector<const Module*>& modules,
+	                                                                uint32_t set)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		for (const Module* module : modules)
+		{
+			for (const Binding& binding : module->bindings)
+			{
+				if (binding.set != set) continue;
+
+				auto found = std::find_if(bindings.begin(), bindings.end(),
+				                          [&binding](const VkDescriptorSetLayoutBinding& layoutBinding)
+				                          {
+					                          return layoutBinding.binding == binding.binding;
+				                          });
+				if (found == bindings.end())
+				{
+					VkDescriptorSetLayoutBinding layoutBinding{};
+					layoutBinding.binding = binding.binding;
+					layoutBinding.descriptorType = binding.type;
+					layoutBinding.descriptorCount = binding.count;
+					layoutBinding.stageFlags = module->stage;
+					bindings.push_back(layoutBinding);
+					continue;
+				}
+				if (found->descriptorType != binding.type)
+				{
+					throw std::runtime_error("shaders disagree about the type of a descriptor binding!");
+				}
+				found->descriptorCount = std::max(found->descriptorCount, binding.count);
+				found->stageFlags |= module->stage;
+			}
+		}
+		std::sort(bindings.begin(), bindings.end(), [](const auto& a, const auto& b)
+		{
+			return a.binding < b.binding;
+		});
+		return bindings;
+	}
+
+	// One range over every module's push constants, for all of their stages, so a single push reaches them all.
+	// size is 0 when none of them has push constants.
+	static VkPushConstantRange getPushConstantRange(const std::vector<const Module*>& modules)
+	{
+		VkPushConstantRange range{};
+		uint32_t end = 0;
+		for (const Module* module : modules)
+		{
+			if (module->pushConstantSize == 0) continue;
+
+			range.offset = range.stageFlags == 0 ? module->pushConstantOffset :
+				std::min(range.offset, module->pushConstantOffset);
+			end = std::max(end, module->pushConstantOffset + module->pushConstantSize);
+			range.stageFlags |= module->stage;
+		}
+		range.size = end - range.offset;
+		return range;
+	}
+
+	// Vertex input for the inputs of a vertex shader. bindingOf gives the binding a location is read from, the
+	// attributes of a binding are packed in location order with nothing in between.
+	static void getVertexInput(const Module& module, const std::function<uint32_t(uint32_t location)>& bindingOf,
+	                           std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
+	                           std::vector<VkVertexInputAttributeDescription>& attributeDescriptions)
+	{
+		bindingDescriptions.clear();
+		attributeDescriptions.clear();
+		for (const Input& input : module.inputs)
+		{
+			uint32_t binding = bindingOf(input.location);
+			auto found = std::find_if(bindingDescriptions.begin(), bindingDescriptions.end(),
+			                          [binding](const VkVertexInputBindingDescription& description)
+			                          {
+				                          return description.binding == binding;
+			                          });
+			if (found == bindingDescriptions.end())
+			{
+				bindingDescriptions.push_back({binding, 0, VK_VERTEX_INPUT_RATE_VERTEX});
+				found = bindingDescriptions.end() - 1;
+			}
+
+			VkVertexInputAttributeDescription attribute{};
+			attribute.location = input.location;
+			attribute.binding = binding;
+			attribute.format = input.format;
+			attribute.offset = found->stride;
+			attributeDescriptions.push_back(attribute);
+			found->stride += input.size;
+		}
+		std::sort(bindingDescriptions.begin(), bindingDescriptions.end(), [](const auto& a, const auto& b)
+		{
+			return a.binding < b.binding;
+		});
+	}
+
+	// Layouts with the same sets and range are shared, they belong to the reflection
+	VkPipelineLayout getPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+	                                   const VkPushConstantRange& pushConstantRange)
+	{
+		LayoutKey key{setLayouts, pushConstantRange};
+		auto found = pipelineLayouts.find(key);
+		if (found != pipelineLayouts.end())
+		{
+			return found->second;
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+		pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+		pipelineLayoutInfo.pushConstantRangeCount = pushConstantRange.size > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout pipelineLayout;
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+		{
+			throw std::runtime_error("failed to create pipeline layout!");
+		}
+		pipelineLayouts.emplace(std::move(key), pipelineLayout);
+		return pipelineLayout;
+	}
+
+	const Stats& getStats() const { return stats; }
+	uint32_t getModuleCount() const { return static_cast<uint32_t>(modules.size()); }
+	uint32_t getPipelineLayoutCount() const { return static_cast<uint32_t>(pipelineLayouts.size()); }
+
+private:
+	// From the SPIR-V specification, only what is read here
+	static constexpr uint32_t SPIRV_MAGIC = 0x07230203;
+	enum : uint32_t
+	{
+		OP_ENTRY_POINT = 15,
+		OP_TYPE_BOOL = 20,
+		OP_TYPE_INT = 21,
+		OP_TYPE_FLOAT = 22,
+		OP_TYPE_VECTOR = 23,
+		OP_TYPE_MATRIX = 24,
+		OP_TYPE_IMAGE = 25,
+		OP_TYPE_SAMPLER = 26,
+		OP_TYPE_SAMPLED_IMAGE = 27,
+		OP_TYPE_ARRAY = 28,
+		OP_TYPE_RUNTIME_ARRAY = 29,
+		OP_TYPE_STRUCT = 30,
+		OP_TYPE_POINTER = 32,
+		OP_CONSTANT = 43,
+		OP_SPEC_CONSTANT = 50,
+		OP_FUNCTION = 54,
+		OP_VARIABLE = 59,
+		OP_DECORATE = 71,
+		OP_MEMBER_DECORATE = 72
+	};
+	enum : uint32_t
+	{
+		DECORATION_BUFFER_BLOCK = 3,
+		DECORATION_ARRAY_STRIDE = 6,
+		DECORATION_MATRIX_STRIDE = 7,
+		DECORATION_LOCATION = 30,
+		DECORATION_BINDING = 33,
+		DECORATION_DESCRIPTOR_SET = 34,
+		DECORATION_OFFSET = 35
+	};
+	enum : uint32_t
+	{
+		STORAGE_UNIFORM_CONSTANT = 0,
+		STORAGE_INPUT = 1,
+		STORAGE_UNIFORM = 2,
+		STORAGE_PUSH_CONSTANT = 9,
+		STORAGE_STORAGE_BUFFER = 12
+	};
+	enum : uint32_t
+	{
+		DIM_BUFFER = 5,
+		DIM_SUBPASS_DATA = 6
+	};
+
+	struct Member
+	{
+		uint32_t offset = 0;
+		uint32_t matrixStride = 0;
+	};
+
+	struct Id
+	{
+		uint32_t opcode = 0;
+		std::vector<uint32_t> operands; // of the declaration, without the result id
+		uint32_t value = 0; // constants
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		uint32_t location = 0;
+		bool hasLocation = false;
+		bool bufferBlock = false;
+		uint32_t arrayStride = 0;
+		std::vector<Member> members; // structs
+	};
+
+	struct LayoutKey
+	{
+		std::vector<VkDescriptorSetLayout> setLayouts;
+		VkPushConstantRange range;
+
+		bool operator==(const LayoutKey& other) const
+		{
+			return setLayouts == other.setLayouts && range.stageFlags == other.range.stageFlags &&
+				range.offset == other.range.offset && range.size == other.range.size;
+		}
+	};
+
+	struct LayoutKeyHash
+	{
+		size_t operator()(const LayoutKey& key) const
+		{
+			uint64_t hash = TutUtils::hashBytes(key.setLayouts.data(),
+			                                    key.setLayouts.size() * sizeof(VkDescriptorSetLayout));
+			return static_cast<size_t>(TutUtils::hashBytes(&key.range, sizeof(key.range), hash));
+		}
+	};
+
+	// Words an instruction has at least, with the opcode, for what parse() reads of it
+	static uint32_t getMinLength(uint32_t opcode)
+	{
+		switch (opcode)
+		{
+		case OP_ENTRY_POINT: return 3;
+		case OP_DECORATE: return 3;
+		case OP_MEMBER_DECORATE: return 4;
+		case OP_CONSTANT:
+		case OP_SPEC_CONSTANT:
+		case OP_VARIABLE: return 4;
+		case OP_TYPE_BOOL:
+		case OP_TYPE_INT:
+		case OP_TYPE_FLOAT:
+		case OP_TYPE_VECTOR:
+		case OP_TYPE_MATRIX:
+		case OP_TYPE_IMAGE:
+		case OP_TYPE_SAMPLER:
+		case OP_TYPE_SAMPLED_IMAGE:
+		case OP_TYPE_ARRAY:
+		case OP_TYPE_RUNTIME_ARRAY:
+		case OP_TYPE_STRUCT:
+		case OP_TYPE_POINTER: return 2;
+		default: return 1;
+		}
+	}
+
+	static Id& getId(std::vector<Id>& ids, uint32_t id)
+	{
+		if (id >= ids.size())
+		{
+			throw std::runtime_error("failed to reflect shader, id out of bounds!");
+		}
+		return ids[id];
+	}
+
+	static void declareType(std::vector<Id>& ids, uint32_t opcode, const uint32_t* operands, uint32_t count)
+	{
+		// Types are declared before they are used, which also keeps the walks over them from going in circles
+		uint32_t used = 0; // how many of the operands are types
+		switch (opcode)
+		{
+		case OP_TYPE_VECTOR:
+		case OP_TYPE_MATRIX:
+		case OP_TYPE_ARRAY:
+		case OP_TYPE_RUNTIME_ARRAY:
+		case OP_TYPE_SAMPLED_IMAGE: used = 1; break;
+		case OP_TYPE_STRUCT: used = count - 1; break;
+		default: break;
+		}
+		for (uint32_t i = 0; i < used && 1 + i < count; i++)
+		{
+			if (getId(ids, operands[1 + i]).opcode == 0)
+			{
+				throw std::runtime_error("failed to reflect shader, type used before it is declared!");
+			}
+		}
+
+		Id& type = getId(ids, operands[0]);
+		if (type.opcode != 0)
+		{
+			throw std::runtime_error("failed to reflect shader, id declared twice!");
+		}
+		type.opcode = opcode;
+		type.operands.assign(operands + 1, operands + count);
+	}
+
+	static void decorate(std::vector<Id>& ids, uint32_t target, uint32_t decoration, uint32_t value)
+	{
+		Id& id = getId(ids, target);
+		switch (decoration)
+		{
+		case DECORATION_DESCRIPTOR_SET: id.set = value; break;
+		case DECORATION_BINDING: id.binding = value; break;
+		case DECORATION_LOCATION: id.location = value; id.hasLocation = true; break;
+		case DECORATION_BUFFER_BLOCK: id.bufferBlock = true; break;
+		case DECORATION_ARRAY_STRIDE: id.arrayStride = value; break;
+		default: break;
+		}
+	}
+
+	static VkShaderStageFlagBits getStage(uint32_t executionModel)
+	{
+		switch (executionModel)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default: throw std::runtime_error("failed to reflect shader, unknown stage!");
+		}
+	}
+
+	static Binding getBinding(const std::vector<Id>& ids, const Id& variable, uint32_t storageClass, uint32_t type)
+	{
+		Binding binding{variable.set, variable.binding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1};
+
+		// Arrays of descriptors
+		while (ids.at(type).opcode == OP_TYPE_ARRAY || ids.at(type).opcode == OP_TYPE_RUNTIME_ARRAY)
+		{
+			const Id& array = ids[type];
+			binding.count = array.opcode == OP_TYPE_RUNTIME_ARRAY ? 0 :
+				binding.count * ids.at(array.operands.at(1)).value;
+			type = array.operands.at(0);
+		}
+
+		const Id& element = ids[type];
+		if (storageClass == STORAGE_STORAGE_BUFFER || (storageClass == STORAGE_UNIFORM && element.bufferBlock))
+		{
+			binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		}
+		else if (storageClass == STORAGE_UNIFORM)
+		{
+			binding.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		}
+		else if (element.opcode == OP_TYPE_SAMPLED_IMAGE)
+		{
+			binding.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		}
+		else if (element.opcode == OP_TYPE_SAMPLER)
+		{
+			binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+		}
+		else if (element.opcode == OP_TYPE_IMAGE)
+		{
+			// sampled type, dim, depth, arrayed, multisampled, sampled (1: with a sampler, 2: storage), format
+			uint32_t dim = element.operands.at(1);
+			bool storage = element.operands.at(5) == 2;
+			if (dim == DIM_SUBPASS_DATA) binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+			else if (dim == DIM_BUFFER) binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER :
+				VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+			else binding.type = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		}
+		else
+		{
+			throw std::runtime_error("failed to reflect shader, unknown descriptor type!");
+		}
+		return binding;
+	}
+
+	// Bytes a value of type takes in a block, matrixStride comes from the member it is in
+	static uint32_t getSize(const std::vector<Id>& ids, uint32_t type, uint32_t matrixStride)
+	{
+		const Id& id = ids.at(type);
+		switch (id.opcode)
+		{
+		case OP_TYPE_BOOL: return 4;
+		case OP_TYPE_INT:
+		case OP_TYPE_FLOAT: return id.operands.at(0) / 8;
+		case OP_TYPE_VECTOR: return id.operands.at(1) * getSize(ids, id.operands.at(0), 0);
+		case OP_TYPE_MATRIX:
+			return id.operands.at(1) * (matrixStride > 0 ? matrixStride : getSize(ids, id.operands.at(0), 0));
+		case OP_TYPE_ARRAY:
+		{
+			uint32_t length = ids.at(id.operands.at(1)).value;
+			return length * (id.arrayStride > 0 ? id.arrayStride : getSize(ids, id.operands.at(0), matrixStride));
+		}
+		case OP_TYPE_STRUCT:
+		{
+			uint32_t offset = 0;
+			uint32_t size = 0;
+			getMemberRange(ids, id, offset, size);
+			return offset + size;
+		}
+		default:
+			throw std::runtime_error("failed to reflect shader, unsized type in a block!");
+		}
+	}
+
+	// From the first member's offset to the end of the last one
+	static void getMemberRange(const std::vector<Id>& ids, const Id& block, uint32_t& offset, uint32_t& size)
+	{
+		uint32_t begin = UINT32_MAX;
+		uint32_t end = 0;
+		for (size_t i = 0; i < block.operands.size(); i++)
+		{
+			Member member = i < block.members.size() ? block.members[i] : Member{};
+			begin = std::min(begin, member.offset);
+			end = std::max(end, member.offset + getSize(ids, block.operands[i], member.matrixStride));
+		}
+		offset = block.operands.empty() ? 0 : begin;
+		size = end - offset;
+	}
+
+	// Matrices take a location per column
+	static void addInputs(const std::vector<Id>& ids, uint32_t type, uint32_t location, std::vector<Input>& inputs)
+	{
+		const Id& id = ids.at(type);
+		if (id.opcode == OP_TYPE_MATRIX && id.operands.at(1) <= 4)
+		{
+			for (uint32_t column = 0; column < id.operands.at(1); column++)
+			{
+				addInputs(ids, id.operands.at(0), location + column, inputs);
+			}
+			return;
+		}
+
+		uint32_t componentType = id.opcode == OP_TYPE_VECTOR ? id.operands.at(0) : type;
+		uint32_t components = id.opcode == OP_TYPE_VECTOR ? id.operands.at(1) : 1;
+		const Id& component = ids.at(componentType);
+		if ((component.opcode != OP_TYPE_INT && component.opcode != OP_TYPE_FLOAT) || components > 4)
+		{
+			throw std::runtime_error("failed to reflect shader, unsupported vertex input type!");
+		}
+		uint32_t width = component.operands.at(0);
+		bool isFloat = component.opcode == OP_TYPE_FLOAT;
+		bool isSigned = isFloat || component.operands.at(1) == 1;
+		inputs.push_back({location, getFormat(width, components, isFloat, isSigned), width / 8 * components});
+	}
+
+	// float: VK_FORMAT_R32_SFLOAT
+	// vec2: VK_FORMAT_R32G32_SFLOAT
+	// vec3: VK_FORMAT_R32G32B32_SFLOAT
+	// vec4: VK_FORMAT_R32G32B32A32_SFLOAT
+	// ivec2: VK_FORMAT_R32G32_SINT, a 2-component vector of 32-bit signed integers
+	// uvec4: VK_FORMAT_R32G32B32A32_UINT, a 4-component vector of 32-bit unsigned integers
+	// double: VK_FORMAT_R64_SFLOAT, a double-precision (64-bit) float
+	static VkFormat getFormat(uint32_t width, uint32_t components, bool isFloat, bool isSigned)
+	{
+		VkFormat first;
+		if (width == 32) first = isFloat ? VK_FORMAT_R32_SFLOAT : isSigned ? VK_FORMAT_R32_SINT : VK_FORMAT_R32_UINT;
+		else if (width == 64) first = isFloat ? VK_FORMAT_R64_SFLOAT : isSigned ? VK_FORMAT_R64_SINT : VK_FORMAT_R64_UINT;
+		else throw std::runtime_error("failed to reflect shader, unsupported vertex input width!");
+		// R32_UINT, R32_SINT, R32_SFLOAT, R32G32_UINT, ...: three formats per component count
+		return static_cast<VkFormat>(first + 3 * (components - 1));
+	}
+
+	VkDevice device = VK_NULL_HANDLE;
+	std::unordered_map<uint64_t, Module> modules; // by TutUtils::hashBytes() of the code
+	std::unordered_map<LayoutKey, VkPipelineLayout, LayoutKeyHash> pipelineLayouts;
+	Stats stats;
+};
+
+#endif /* ShaderReflection_h */
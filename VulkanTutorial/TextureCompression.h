@@ -0,0 +1,188 @@
+//
+//  TextureCompression.h
+//  VulkanTutorial
+//
+
+#ifndef TextureCompression_h
+#define TextureCompression_h
+
+#include <vulkan/vulkan.h>
+#include <stb_dxt.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include "Utils.h"
+
+// One mip level of a CPU side texture, tightly packed
+struct TextureLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<unsigned char> data;
+};
+
+// Non-owning view of one mip level, e.g. into a memory mapped file
+struct TextureLevelView
+{
+	const unsigned char* data = nullptr;
+	VkDeviceSize size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+};
+
+// What the upload path consumes, a mip chain in a single format, level 0 first
+struct TextureView
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::vector<TextureLevelView> levels;
+
+	VkDeviceSize getSize() const
+	{
+		VkDeviceSize size = 0;
+		for (const auto& level : levels)
+		{
+			size += level.size;
+		}
+		return size;
+	}
+};
+
+// A full mip chain in a single format, level 0 first
+struct TextureData
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	std::vector<TextureLevel> levels;
+
+	VkDeviceSize getSize() const
+	{
+		VkDeviceSize size = 0;
+		for (const auto& level : levels)
+		{
+			size += level.data.size();
+		}
+		return size;
+	}
+
+	TextureView getView() const
+	{
+		TextureView view;
+		view.format = format;
+		for (const auto& level : levels)
+		{
+			view.levels.push_back({level.data.data(), level.data.size(), level.width, level.height});
+		}
+		return view;
+	}
+};
+
+// Block compressed formats stb_dxt can encode
+//  BC1: RGB, 8 bytes per 4x4 block
+//  BC3: RGBA, 16 bytes per block (BC1 color + BC4 alpha)
+//  BC4: single channel (R), 8 bytes per block
+//  BC5: two channels (RG), 16 bytes per block, e.g. tangent space normals
+enum class BlockFormat
+{
+	BC1,
+	BC3,
+	BC4,
+	BC5
+};
+
+class TextureCompression
+{
+public:
+	static VkFormat getVkFormat(BlockFormat format, bool srgb)
+	{
+		switch (format)
+		{
+		case BlockFormat::BC1: return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+		case BlockFormat::BC3: return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+		case BlockFormat::BC4: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case BlockFormat::BC5: return VK_FORMAT_BC5_UNORM_BLOCK;
+		}
+		return VK_FORMAT_UNDEFINED;
+	}
+
+	static uint32_t getBlockSize(BlockFormat format)
+	{
+		return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+	}
+
+	// BC1 for opaque textures, BC3 as soon as a single texel is not fully opaque
+	static BlockFormat pickColorFormat(const TextureLevel& rgba)
+	{
+		for (size_t i = 3; i < rgba.data.size(); i += 4)
+		{
+			if (rgba.data[i] != 255) return BlockFormat::BC3;
+		}
+		return BlockFormat::BC1;
+	}
+
+	// Encodes every level of an RGBA8 mip chain, block rows are spread over all cores.
+	// BC4 reads the R channel, BC5 R and G.
+	static TextureData compress(const TextureData& rgba, BlockFormat format, bool srgb)
+	{
+		TextureData compressed;
+		compressed.format = getVkFormat(format, srgb);
+		compressed.levels.resize(rgba.levels.size());
+
+		uint32_t blockSize = getBlockSize(format);
+		for (size_t l = 0; l < rgba.levels.size(); l++)
+		{
+			const TextureLevel& src = rgba.levels[l];
+			TextureLevel& dst = compressed.levels[l];
+			uint32_t blocksX = (src.width + 3) / 4;
+			uint32_t blocksY = (src.height + 3) / 4;
+			dst.width = src.width;
+			dst.height = src.height;
+			dst.data.resize(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+			TutUtils::parallelFor(blocksY, [&](uint32_t by)
+			{
+				unsigned char block[16 * 4];
+				unsigned char channels[16 * 2];
+				for (uint32_t bx = 0; bx < blocksX; bx++)
+				{
+					// Gather the 4x4 block, repeating the last row / column past the edge
+					for (uint32_t y = 0; y < 4; y++)
+					{
+						uint32_t sy = std::min(by * 4 + y, src.height - 1);
+						for (uint32_t x = 0; x < 4; x++)
+						{
+							uint32_t sx = std::min(bx * 4 + x, src.width - 1);
+							memcpy(&block[(y * 4 + x) * 4], &src.data[(static_cast<size_t>(sy) * src.width + sx) * 4], 4);
+						}
+					}
+
+					unsigned char* out = &dst.data[(static_cast<size_t>(by) * blocksX + bx) * blockSize];
+					switch (format)
+					{
+					case BlockFormat::BC1:
+						stb_compress_dxt_block(out, block, 0, STB_DXT_HIGHQUAL);
+						break;
+					case BlockFormat::BC3:
+						stb_compress_dxt_block(out, block, 1, STB_DXT_HIGHQUAL);
+						break;
+					case BlockFormat::BC4:
+						for (int i = 0; i < 16; i++) channels[i] = block[i * 4];
+						stb_compress_bc4_block(out, channels);
+						break;
+					case BlockFormat::BC5:
+						for (int i = 0; i < 16; i++)
+						{
+							channels[i * 2] = block[i * 4];
+							channels[i * 2 + 1] = block[i * 4 + 1];
+						}
+						stb_compress_bc5_block(out, channels);
+						break;
+					}
+				}
+			});
+		}
+
+		return compressed;
+	}
+};
+
+#endif /* TextureCompression_h */
@@ -0,0 +1,234 @@
+//
+//  TextureDecoder.h
+//  VulkanTutorial
+//
+
+#ifndef TextureDecoder_h
+#define TextureDecoder_h
+
+#include <stb_image.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <queue>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+#include "Utils.h"
+
+// An RGBA8 image as stb_image decoded it
+struct DecodedImage
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	size_t sourceSize = 0; // of the encoded file
+	std::unique_ptr<stbi_uc, void (*)(void*)> pixels{nullptr, stbi_image_free};
+
+	size_t getSize() const
+	{
+		return static_cast<size_t>(width) * height * 4;
+	}
+};
+
+// Decodes JPEG / PNG files on a pool of worker threads.
+// Each file is memory mapped and handed to stbi_load_from_memory, so the encoded bytes never go through stdio buffers.
+// stb_image keeps its error state thread local, any number of decodes can run at the same time.
+class TextureDecoder
+{
+public:
+	explicit TextureDecoder(uint32_t workerCount = TutUtils::getWorkerCount())
+	{
+		for (uint32_t i = 0; i < std::max(workerCount, 1u); i++)
+		{
+			workers.emplace_back([this]() { work(); });
+		}
+	}
+
+	TextureDecoder(const TextureDecoder&) = delete;
+	TextureDecoder& operator=(const TextureDecoder&) = delete;
+
+	// Queued decodes still run before the workers exit
+	~TextureDecoder()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	std::future<DecodedImage> decode(const std::string& path)
+	{
+		std::packaged_task<DecodedImage()> task([path]() { return decodeFile(path); });
+		std::future<DecodedImage> result = task.get_future();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push(std::move(task));
+		}
+		wakeUp.notify_one();
+		return result;
+	}
+
+	// Results in the order of paths, the first failure is rethrown
+	std::vector<DecodedImage> decodeAll(const std::vector<std::string>& paths)
+	{
+		std::vector<std::future<DecodedImage>> pending;
+		for (const auto& path : paths)
+		{
+			pending.push_back(decode(path));
+		}
+
+		std::vector<DecodedImage> images;
+		for (auto& image : pending)
+		{
+			images.push_back(image.get());
+		}
+		return images;
+	}
+
+	// Decodes on the calling thread
+	static DecodedImage decodeFile(const std::string& path)
+	{
+		MappedFile file;
+		if (!file.open(path))
+		{
+			throw std::runtime_error("failed to load texture image!");
+		}
+
+		int texWidth, texHeight, texChannels;
+		DecodedImage image;
+		image.pixels.reset(stbi_load_from_memory(file.data(), static_cast<int>(file.size()),
+		                                         &texWidth, &texHeight, &texChannels, STBI_rgb_alpha));
+		if (!image.pixels)
+		{
+			throw std::runtime_error("failed to load texture image!");
+		}
+		image.width = static_cast<uint32_t>(texWidth);
+		image.height = static_cast<uint32_t>(texHeight);
+		image.sourceSize = file.size();
+		return image;
+	}
+
+	// Size of the RGBA8 output without decoding anything
+	static bool getInfo(const MappedFile& file, uint32_t& width, uint32_t& height)
+	{
+		int texWidth, texHeight, texChannels;
+		if (!stbi_info_from_memory(file.data(), static_cast<int>(file.size()), &texWidth, &texHeight, &texChannels))
+		{
+			return false;
+		}
+		width = static_cast<uint32_t>(texWidth);
+		height = static_cast<uint32_t>(texHeight);
+		return true;
+	}
+
+	// Space decodeInto() needs, the RGBA8 pixels plus the spare byte stb_image's JPEG output asks for
+	static size_t getDecodeCapacity(uint32_t width, uint32_t height)
+	{
+		return static_cast<size_t>(width) * height * 4 + 1;
+	}
+
+	// Decodes RGBA8 pixels to the start of destination, which holds getDecodeCapacity() bytes.
+	// stb_image's first allocation of the output size is served from destination. That is the final output for JPEG
+	// and most 8 bit PNG; anything that needs one more conversion pass lands on the heap and is copied over.
+	// Returns true if nothing had to be copied.
+	static bool decodeInto(const MappedFile& file, unsigned char* destination, size_t capacity)
+	{
+		arena = {destination, capacity, false};
+		int texWidth, texHeight, texChannels;
+		stbi_uc* pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &texWidth, &texHeight,
+		                                        &texChannels, STBI_rgb_alpha);
+		arena = {};
+
+		if (pixels == destination)
+		{
+			return true;
+		}
+		size_t size = static_cast<size_t>(texWidth) * texHeight * 4;
+		if (!pixels || size >= capacity)
+		{
+			stbi_image_free(pixels);
+			throw std::runtime_error("failed to load texture image!");
+		}
+		memcpy(destination, pixels, size);
+		stbi_image_free(pixels);
+		return false;
+	}
+
+	// STBI_MALLOC, STBI_REALLOC and STBI_FREE, hooked up where stb_image is implemented
+	static void* allocate(size_t size)
+	{
+		if (arena.target != nullptr && !arena.claimed && (size == arena.size || size + 1 == arena.size))
+		{
+			arena.claimed = true;
+			return arena.target;
+		}
+		return malloc(size);
+	}
+
+	static void* reallocate(void* pointer, size_t size)
+	{
+		if (pointer == nullptr || pointer != arena.target)
+		{
+			return realloc(pointer, size);
+		}
+		// Something is growing the claimed block, it moves to the heap for good
+		void* moved = malloc(size);
+		if (moved != nullptr)
+		{
+			memcpy(moved, pointer, std::min(size, arena.size));
+		}
+		arena.target = nullptr;
+		return moved;
+	}
+
+	static void release(void* pointer)
+	{
+		if (pointer != nullptr && pointer == arena.target) return;
+		free(pointer);
+	}
+
+private:
+	// Destination of the decode running on this thread, zeroed when there is none
+	struct Arena
+	{
+		unsigned char* target;
+		size_t size;
+		bool claimed;
+	};
+	static inline thread_local Arena arena;
+
+	std::vector<std::thread> workers;
+	std::queue<std::packaged_task<DecodedImage()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+
+	void work()
+	{
+		while (true)
+		{
+			std::packaged_task<DecodedImage()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+				if (tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			// exceptions end up in the task's future
+			task();
+		}
+	}
+};
+
+#endif /* TextureDecoder_h */
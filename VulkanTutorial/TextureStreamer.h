@@ -0,0 +1,226 @@
+//
+//  TextureStreamer.h
+//  VulkanTutorial
+//
+
+#ifndef TextureStreamer_h
+#define TextureStreamer_h
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "TextureCompression.h"
+
+// Texture residency under a memory budget
+// Every texture keeps its whole mip chain readable on the CPU (a memory mapped KTX2 file or a baked copy), the GPU
+// only holds the levels from firstLevel down to the last one. Textures start out with their coarsest levels and
+// stream in finer ones as they grow on screen:
+//  1. setScreenSize() turns the pixels a texture covers into the level it wants, one texel per pixel
+//  2. update() plans the frame's changes: every texture aims for its wanted level, or keeps finer levels it already
+//     has as long as they fit. While the sum is over budget the biggest surplus level goes first, then the
+//     biggest level anybody wants. Evictions are immediate, streaming in goes one level per texture and update,
+//     with all new levels together within maxUploadSize.
+//  3. The caller re-creates the texture's image with the new levels, copying over the ones it keeps, and reports
+//     back with setFirstLevel(). Nothing changes until then, so a failed allocation just leaves the texture as is.
+// Sizes are what the levels take in the source, the image may be a little larger for alignment.
+class TextureStreamer
+{
+public:
+	// The texture's image should hold levels [firstLevel, levelCount) instead of [oldFirstLevel, levelCount)
+	struct Change
+	{
+		uint32_t texture;
+		uint32_t oldFirstLevel;
+		uint32_t firstLevel;
+	};
+
+	struct Stats
+	{
+		uint64_t streamedLevels = 0;
+		uint64_t evictedLevels = 0;
+		uint64_t uploadedBytes = 0;
+	};
+
+	// Bytes of every level from firstLevel on
+	static VkDeviceSize getSize(const TextureView& source, uint32_t firstLevel)
+	{
+		VkDeviceSize size = 0;
+		for (size_t level = firstLevel; level < source.levels.size(); level++)
+		{
+			size += source.levels[level].size;
+		}
+		return size;
+	}
+
+	// The levels an image starting at firstLevel holds, its level 0 is the source's firstLevel
+	static TextureView getLevels(const TextureView& source, uint32_t firstLevel)
+	{
+		TextureView view;
+		view.format = source.format;
+		view.levels.assign(source.levels.begin() + firstLevel, source.levels.end());
+		return view;
+	}
+
+	// The source has to stay valid for as long as the streamer is used.
+	// The texture starts with the coarsest levels that fit in initialSize, at least the last one.
+	uint32_t add(const TextureView& source, VkDeviceSize initialSize)
+	{
+		if (source.levels.empty())
+		{
+			throw std::runtime_error("streamed texture has no levels!");
+		}
+
+		Texture texture;
+		texture.source = source;
+		texture.firstLevel = static_cast<uint32_t>(source.levels.size()) - 1;
+		while (texture.firstLevel > 0 && getSize(source, texture.firstLevel - 1) <= initialSize)
+		{
+			texture.firstLevel--;
+		}
+		texture.wantedLevel = texture.firstLevel;
+		textures.push_back(texture);
+		return static_cast<uint32_t>(textures.size()) - 1;
+	}
+
+	void setBudget(VkDeviceSize budget) { this->budget = budget; }
+
+	// pixels: how many pixels the texture's width spans on screen
+	void setScreenSize(uint32_t texture, float pixels)
+	{
+		Texture& t = textures[texture];
+		float lod = std::log2(static_cast<float>(t.source.levels[0].width) / std::max(pixels, 1.0f));
+		t.wantedLevel = std::min(static_cast<uint32_t>(std::max(std::floor(lod), 0.0f)), getLastLevel(texture));
+	}
+
+	std::vector<Change> update(VkDeviceSize maxUploadSize)
+	{
+		// Keep what is resident, add what is wanted
+		std::vector<uint32_t> targets(textures.size());
+		VkDeviceSize total = 0;
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			targets[i] = std::min(textures[i].firstLevel, textures[i].wantedLevel);
+			total += getSize(textures[i].source, targets[i]);
+		}
+
+		// Over budget: drop the largest finest level, surplus ones before wanted ones
+		while (total > budget)
+		{
+			size_t victim = textures.size();
+			bool victimSurplus = false;
+			VkDeviceSize victimSize = 0;
+			for (size_t i = 0; i < textures.size(); i++)
+			{
+				if (targets[i] >= getLastLevel(static_cast<uint32_t>(i))) continue;
+
+				bool surplus = targets[i] < textures[i].wantedLevel;
+				VkDeviceSize size = textures[i].source.levels[targets[i]].size;
+				if (victim == textures.size() || (surplus && !victimSurplus) ||
+					(surplus == victimSurplus && size > victimSize))
+				{
+					victim = i;
+					victimSurplus = surplus;
+					victimSize = size;
+				}
+			}
+			if (victim == textures.size()) break; // down to the last levels, nothing left to drop
+
+			total -= victimSize;
+			targets[victim]++;
+		}
+
+		std::vector<Change> changes;
+		std::vector<uint32_t> streamIn;
+		for (size_t i = 0; i < textures.size(); i++)
+		{
+			uint32_t texture = static_cast<uint32_t>(i);
+			if (targets[i] > textures[i].firstLevel)
+			{
+				changes.push_back({texture, textures[i].firstLevel, targets[i]});
+			}
+			else if (targets[i] < textures[i].firstLevel)
+			{
+				streamIn.push_back(texture);
+			}
+		}
+
+		// The textures furthest from their target first, the first one even if its level is over maxUploadSize
+		std::sort(streamIn.begin(), streamIn.end(), [&](uint32_t a, uint32_t b)
+		{
+			return textures[a].firstLevel - targets[a] > textures[b].firstLevel - targets[b];
+		});
+		VkDeviceSize uploadSize = 0;
+		for (uint32_t texture : streamIn)
+		{
+			uint32_t level = textures[texture].firstLevel - 1;
+			VkDeviceSize size = textures[texture].source.levels[level].size;
+			if (uploadSize > 0 && uploadSize + size > maxUploadSize) continue;
+
+			uploadSize += size;
+			changes.push_back({texture, textures[texture].firstLevel, level});
+		}
+		return changes;
+	}
+
+	// The image of texture now holds the levels from firstLevel on
+	void setFirstLevel(uint32_t texture, uint32_t firstLevel)
+	{
+		Texture& t = textures[texture];
+		if (firstLevel < t.firstLevel)
+		{
+			stats.streamedLevels += t.firstLevel - firstLevel;
+			stats.uploadedBytes += getSize(t.source, firstLevel) - getSize(t.source, t.firstLevel);
+		}
+		else
+		{
+			stats.evictedLevels += firstLevel - t.firstLevel;
+		}
+		t.firstLevel = firstLevel;
+	}
+
+	const TextureView& getSource(uint32_t texture) const { return textures[texture].source; }
+	uint32_t getFirstLevel(uint32_t texture) const { return textures[texture].firstLevel; }
+	uint32_t getWantedLevel(uint32_t texture) const { return textures[texture].wantedLevel; }
+	uint32_t getLastLevel(uint32_t texture) const { return static_cast<uint32_t>(textures[texture].source.levels.size()) - 1; }
+	uint32_t getTextureCount() const { return static_cast<uint32_t>(textures.size()); }
+	VkDeviceSize getBudget() const { return budget; }
+	const Stats& getStats() const { return stats; }
+
+	VkDeviceSize getResidentSize() const
+	{
+		VkDeviceSize size = 0;
+		for (const auto& texture : textures)
+		{
+			size += getSize(texture.source, texture.firstLevel);
+		}
+		return size;
+	}
+
+	// What every texture would take fully resident
+	VkDeviceSize getFullSize() const
+	{
+		VkDeviceSize size = 0;
+		for (const auto& texture : textures)
+		{
+			size += texture.source.getSize();
+		}
+		return size;
+	}
+
+private:
+	struct Texture
+	{
+		TextureView source;
+		uint32_t firstLevel = 0; // finest level on the GPU
+		uint32_t wantedLevel = 0; // finest level the screen size asks for
+	};
+
+	std::vector<Texture> textures;
+	VkDeviceSize budget = ~VkDeviceSize(0);
+	Stats stats;
+};
+
+#endif /* TextureStreamer_h */
@@ -0,0 +1,62 @@
+//
+//  UniformAllocator.h
+//  VulkanTutorial
+//
+
+#ifndef UniformAllocator_h
+#define UniformAllocator_h
+
+#include <vulkan/vulkan.h>
+#include <cstring>
+#include <stdexcept>
+
+// Per-frame linear uniform allocator
+// Every frame in flight owns one large persistently mapped uniform buffer. At the start of a frame the allocator is
+// reset onto that frame's buffer and every object pushes its uniforms behind the previous ones, aligned to
+// minUniformBufferOffsetAlignment. The returned offset goes into vkCmdBindDescriptorSets as the dynamic offset of a
+// UNIFORM_BUFFER_DYNAMIC binding, so one descriptor set serves every object of the frame.
+// The frame's fence guards the whole buffer: once it is signaled nothing on the GPU reads the old data anymore.
+class UniformAllocator
+{
+public:
+	// mapped has to stay valid until the next reset, alignment is minUniformBufferOffsetAlignment (a power of two)
+	void reset(void* mapped, VkDeviceSize size, VkDeviceSize alignment)
+	{
+		this->mapped = static_cast<char*>(mapped);
+		this->size = size;
+		this->alignment = alignment;
+		offset = 0;
+	}
+
+	// Returns the dynamic offset of size bytes of uniforms
+	uint32_t allocate(VkDeviceSize size)
+	{
+		VkDeviceSize start = (offset + alignment - 1) & ~(alignment - 1);
+		if (start + size > this->size)
+		{
+			throw std::runtime_error("uniform allocator is out of space!");
+		}
+		offset = start + size;
+		return static_cast<uint32_t>(start);
+	}
+
+	template <typename T>
+	uint32_t push(const T& data)
+	{
+		uint32_t dynamicOffset = allocate(sizeof(T));
+		memcpy(mapped + dynamicOffset, &data, sizeof(T));
+		return dynamicOffset;
+	}
+
+	// Bytes used this frame, alignment padding included
+	VkDeviceSize getUsed() const { return offset; }
+	VkDeviceSize getSize() const { return size; }
+
+private:
+	char* mapped = nullptr;
+	VkDeviceSize size = 0;
+	VkDeviceSize alignment = 1;
+	VkDeviceSize offset = 0;
+};
+
+#endif /* UniformAllocator_h */
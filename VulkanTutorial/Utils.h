@@ -12,6 +12,31 @@
 #include <iostream>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <functional>
+#include <filesystem>
+#include <algorithm>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
 
 class TutUtils
 {
@@ -93,7 +118,205 @@ public:
 		file.close();
 		return buffer;
 	}
+
+	// Changes whenever the file is rewritten, used to tell whether derived caches are stale
+	static uint64_t getFileStamp(const std::string& filename)
+	{
+		std::error_code error;
+		auto size = std::filesystem::file_size(filename, error);
+		if (error) return 0;
+		auto time = std::filesystem::last_write_time(filename, error);
+		if (error) return 0;
+		return static_cast<uint64_t>(time.time_since_epoch().count()) * 1000003u ^ static_cast<uint64_t>(size);
+	}
+
+	static uint32_t getWorkerCount()
+	{
+		return std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	// 64 bit FNV-1a, seed with a previous result to hash several pieces as one
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 14695981039346656037ull)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = seed;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// Peak resident set size of the process in bytes, 0 where unknown
+	static size_t getPeakResidentMemory()
+	{
+#if defined(_WIN32)
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return counters.PeakWorkingSetSize;
+#elif defined(__linux__)
+		// Not getrusage: its ru_maxrss also remembers every exited thread's peak and can't be reset
+		std::ifstream status("/proc/self/status");
+		std::string line;
+		while (std::getline(status, line))
+		{
+			if (line.rfind("VmHWM:", 0) == 0)
+			{
+				return std::stoull(line.substr(6)) * 1024;
+			}
+		}
+		return 0;
+#else
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+		return static_cast<size_t>(usage.ru_maxrss); // bytes on macOS
+#endif
+	}
+
+	// Starts the peak over from the current resident size. Only Linux can, elsewhere the peak keeps growing.
+	static void resetPeakResidentMemory()
+	{
+#ifdef __linux__
+		std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+	}
+
+	// Runs func(i) for every i in [0, count) on up to workerCount threads, the calling thread included.
+	// Items are handed out one at a time, so uneven items still balance.
+	// The first exception thrown by an item stops the remaining items and is rethrown on the calling thread.
+	static void parallelFor(uint32_t count, const std::function<void(uint32_t)>& func,
+	                        uint32_t workerCount = getWorkerCount())
+	{
+		std::atomic<uint32_t> next{0};
+		std::exception_ptr error;
+		std::mutex errorMutex;
+		auto worker = [&]()
+		{
+			for (uint32_t i = next++; i < count; i = next++)
+			{
+				try
+				{
+					func(i);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(errorMutex);
+					if (!error) error = std::current_exception();
+					next = count;
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < std::min(workerCount, count); i++)
+		{
+			threads.emplace_back(worker);
+		}
+		worker();
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		if (error) std::rethrow_exception(error);
+	}
 };
 
 
+// Read only memory mapping of a whole file, pages are only read in when touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	bool open(const std::string& filename)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return false;
+
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(fileSize.QuadPart);
+
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr)
+		{
+			close();
+			return false;
+		}
+		mapped = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		fd = ::open(filename.c_str(), O_RDONLY);
+		if (fd < 0) return false;
+
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		length = static_cast<size_t>(fileStat.st_size);
+
+		mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED) mapped = nullptr;
+#endif
+		if (mapped == nullptr)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (mapped != nullptr) UnmapViewOfFile(mapped);
+		if (mapping != nullptr) CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (mapped != nullptr) munmap(mapped, length);
+		if (fd >= 0) ::close(fd);
+		fd = -1;
+#endif
+		mapped = nullptr;
+		length = 0;
+	}
+
+	const unsigned char* data() const
+	{
+		return static_cast<const unsigned char*>(mapped);
+	}
+
+	size_t size() const
+	{
+		return length;
+	}
+
+private:
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#else
+	int fd = -1;
+#endif
+	void* mapped = nullptr;
+	size_t length = 0;
+};
+
 #endif /* Utils_h */
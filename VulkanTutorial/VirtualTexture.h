@@ -0,0 +1,495 @@
+//
+//  VirtualTexture.h
+//  VulkanTutorial
+//
+
+#ifndef VirtualTexture_h
+#define VirtualTexture_h
+
+#include <vulkan/vulkan.h>
+#include <stb_image_resize.h>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <list>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#include "Utils.h"
+#include "TextureCompression.h"
+#include "TextureDecoder.h"
+#include "MipGenerator.h"
+
+// Virtual texturing with software indirection
+// The texture is cut into pages of PAGE_SIZE x PAGE_SIZE texels on every mip level and stored in a tiled
+// container (.vtex). Only the pages the camera asks for are resident, in a fixed size atlas of physical pages.
+// A page table image, one texel per page and one mip level per texture level, points every page at its atlas slot,
+// or at the slot of its closest resident ancestor while the page itself is not loaded. shader/VirtualTexture.frag
+// does that lookup itself, so nothing needs sparse binding.
+// Pages are stored with a BORDER texel apron taken from their neighbours, bilinear filtering inside the atlas
+// never bleeds into the next slot.
+//
+// Per frame:
+//  1. the fragment shader writes a 1 into the feedback buffer for every page it wanted
+//  2. processFeedback() reads it once the frame's fence signalled: resident pages move to the front of the LRU list,
+//     missing ones are queued for the worker threads, which copy them out of the memory mapped container
+//  3. collectPages() stages loaded pages, evicting the least recently used ones to make room, and rebuilds
+//     the page table; the caller records the copies into the atlas and the page table image
+//
+// File layout: Header, then every page of level 0 row by row, then level 1 and so on,
+// each page TILE_SIZE x TILE_SIZE RGBA8 (sRGB) texels.
+class VirtualTexture
+{
+public:
+	static constexpr uint32_t PAGE_SIZE = 128;
+	static constexpr uint32_t BORDER = 4;
+	static constexpr uint32_t TILE_SIZE = PAGE_SIZE + 2 * BORDER;
+	static constexpr VkDeviceSize TILE_BYTES = static_cast<VkDeviceSize>(TILE_SIZE) * TILE_SIZE * 4;
+
+	// One page table texel (VK_FORMAT_R8G8B8A8_UINT)
+	struct PageTableEntry
+	{
+		uint8_t slotX;
+		uint8_t slotY;
+		uint8_t level; // of the page that sits in the slot
+		uint8_t resident; // 1 if that is the page itself, 0 for an ancestor
+	};
+
+	// A page collectPages() staged: atlas slot and byte offset of its texels in the staging memory
+	struct PageUpload
+	{
+		uint32_t slotX;
+		uint32_t slotY;
+		VkDeviceSize stagingOffset;
+	};
+
+	struct Stats
+	{
+		uint64_t requests = 0; // pages asked for, summed over frames
+		uint64_t misses = 0; // of those, pages that were not resident
+		uint64_t uploads = 0;
+		uint64_t evictions = 0;
+	};
+
+	VirtualTexture() = default;
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	~VirtualTexture()
+	{
+		close();
+	}
+
+	// Resizes image to power of two sides (at least PAGE_SIZE), generates the mip chain
+	// and writes every level down to the first that fits in a single page
+	static void build(const std::string& filename, const DecodedImage& image, uint64_t sourceStamp)
+	{
+		TextureData rgba;
+		rgba.format = VK_FORMAT_R8G8B8A8_SRGB;
+		rgba.levels.resize(1);
+		TextureLevel& base = rgba.levels[0];
+		base.width = std::max(roundUpToPowerOfTwo(image.width), PAGE_SIZE);
+		base.height = std::max(roundUpToPowerOfTwo(image.height), PAGE_SIZE);
+		base.data.resize(static_cast<size_t>(base.width) * base.height * 4);
+		if (base.width == image.width && base.height == image.height)
+		{
+			memcpy(base.data.data(), image.pixels.get(), base.data.size());
+		}
+		else if (!stbir_resize_uint8_srgb(image.pixels.get(), static_cast<int>(image.width),
+		                                  static_cast<int>(image.height), 0, base.data.data(),
+		                                  static_cast<int>(base.width), static_cast<int>(base.height), 0, 4, 3, 0))
+		{
+			throw std::runtime_error("failed to resize virtual texture!");
+		}
+		MipGenerator::generate(rgba, true);
+
+		Header header{};
+		memcpy(header.magic, MAGIC, sizeof(MAGIC));
+		header.version = VERSION;
+		header.width = rgba.levels[0].width; // base dangles once generate() grew the level vector
+		header.height = rgba.levels[0].height;
+		header.pageSize = PAGE_SIZE;
+		header.border = BORDER;
+		header.levelCount = getLevelCount(header.width, header.height);
+		header.sourceStamp = sourceStamp;
+
+		std::ofstream out(filename, std::ios::binary);
+		if (!out)
+		{
+			throw std::runtime_error("failed to write virtual texture!");
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		// Texels past the level's edge wrap around, like VK_SAMPLER_ADDRESS_MODE_REPEAT
+		std::vector<unsigned char> tile(TILE_BYTES);
+		for (uint32_t level = 0; level < header.levelCount; level++)
+		{
+			const TextureLevel& src = rgba.levels[level];
+			uint32_t pagesX = std::max(src.width / PAGE_SIZE, 1u);
+			uint32_t pagesY = std::max(src.height / PAGE_SIZE, 1u);
+			for (uint32_t y = 0; y < pagesY; y++)
+			{
+				for (uint32_t x = 0; x < pagesX; x++)
+				{
+					for (uint32_t ty = 0; ty < TILE_SIZE; ty++)
+					{
+						uint32_t sy = (y * PAGE_SIZE + ty + src.height - BORDER % src.height) % src.height;
+						for (uint32_t tx = 0; tx < TILE_SIZE; tx++)
+						{
+							uint32_t sx = (x * PAGE_SIZE + tx + src.width - BORDER % src.width) % src.width;
+							memcpy(&tile[(static_cast<size_t>(ty) * TILE_SIZE + tx) * 4],
+							       &src.data[(static_cast<size_t>(sy) * src.width + sx) * 4], 4);
+						}
+					}
+					out.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(tile.size()));
+				}
+			}
+		}
+		if (!out)
+		{
+			throw std::runtime_error("failed to write virtual texture!");
+		}
+	}
+
+	// Maps the container and starts the streamer with an atlas of atlasPages x atlasPages slots.
+	// The single page of the last level is loaded right away and never evicted, every lookup falls back to it.
+	// Returns false if the file is missing, was built from another source (sourceStamp != 0) or with other page sizes.
+	bool open(const std::string& filename, uint64_t sourceStamp, uint32_t atlasPages,
+	          uint32_t workerCount = TutUtils::getWorkerCount())
+	{
+		close();
+		if (!file.open(filename) || file.size() < sizeof(Header)) return false;
+
+		memcpy(&header, file.data(), sizeof(header));
+		if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+			header.pageSize != PAGE_SIZE || header.border != BORDER || header.width < PAGE_SIZE ||
+			header.height < PAGE_SIZE || header.levelCount != getLevelCount(header.width, header.height) ||
+			(sourceStamp != 0 && header.sourceStamp != sourceStamp))
+		{
+			file.close();
+			return false;
+		}
+
+		levelOffsets.clear();
+		uint32_t pageCount = 0;
+		for (uint32_t level = 0; level < header.levelCount; level++)
+		{
+			levelOffsets.push_back(pageCount);
+			pageCount += getPagesX(level) * getPagesY(level);
+		}
+		if (file.size() < sizeof(Header) + pageCount * TILE_BYTES)
+		{
+			file.close();
+			return false;
+		}
+
+		this->atlasPages = std::min(atlasPages, 256u); // slot coordinates are 8 bit in the page table
+		freeSlots.clear();
+		for (uint32_t slot = this->atlasPages * this->atlasPages; slot-- > 1;)
+		{
+			freeSlots.push_back(slot);
+		}
+		pageTable.assign(pageCount, {});
+		stats = {};
+		frame = 0;
+
+		// slot 0: the root page
+		uint32_t root = pageCount - 1;
+		resident[root] = {0, lru.end(), 0};
+		loaded.push_back({root, std::vector<unsigned char>(getPage(root), getPage(root) + TILE_BYTES)});
+		buildPageTable();
+
+		stopping = false;
+		for (uint32_t i = 0; i < std::max(workerCount, 1u); i++)
+		{
+			workers.emplace_back([this]() { work(); });
+		}
+		return true;
+	}
+
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			queue.clear();
+		}
+		wakeUp.notify_all();
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+		workers.clear();
+		loaded.clear();
+		resident.clear();
+		pending.clear();
+		lru.clear();
+		file.close();
+	}
+
+	bool isOpen() const { return !workers.empty(); }
+
+	// Sides of level 0 in texels, power of two
+	uint32_t getWidth() const { return header.width; }
+	uint32_t getHeight() const { return header.height; }
+	uint32_t getLevelCount() const { return header.levelCount; }
+	uint32_t getPagesX(uint32_t level) const { return std::max((header.width >> level) / PAGE_SIZE, 1u); }
+	uint32_t getPagesY(uint32_t level) const { return std::max((header.height >> level) / PAGE_SIZE, 1u); }
+	// Pages of all levels, also the number of feedback buffer and page table entries
+	uint32_t getPageCount() const { return static_cast<uint32_t>(pageTable.size()); }
+	uint32_t getLevelOffset(uint32_t level) const { return levelOffsets[level]; }
+	uint32_t getAtlasPages() const { return atlasPages; }
+	uint32_t getResidentCount() const { return static_cast<uint32_t>(resident.size()); }
+	const std::vector<PageTableEntry>& getPageTable() const { return pageTable; }
+	const Stats& getStats() const { return stats; }
+
+	// What every page of every level would take if the whole texture was loaded
+	VkDeviceSize getFullSize() const { return static_cast<VkDeviceSize>(getPageCount()) * PAGE_SIZE * PAGE_SIZE * 4; }
+
+	// Takes one frame of feedback (getPageCount() entries) and clears it for the next use
+	void processFeedback(uint32_t* requested)
+	{
+		frame++;
+		std::vector<uint32_t> missing;
+		for (uint32_t page = 0; page < getPageCount(); page++)
+		{
+			if (requested[page] == 0) continue;
+			requested[page] = 0;
+			stats.requests++;
+
+			auto found = resident.find(page);
+			if (found != resident.end())
+			{
+				found->second.lastUsed = frame;
+				if (found->second.lruPosition != lru.end())
+				{
+					lru.splice(lru.begin(), lru, found->second.lruPosition);
+				}
+				continue;
+			}
+			stats.misses++;
+			if (pending.insert(page).second)
+			{
+				missing.push_back(page);
+			}
+		}
+		if (missing.empty()) return;
+
+		// Coarse pages first, they stand in for the most pixels
+		std::sort(missing.begin(), missing.end(), [this](uint32_t a, uint32_t b)
+		{
+			return getLevel(a) > getLevel(b);
+		});
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.insert(queue.end(), missing.begin(), missing.end());
+		}
+		wakeUp.notify_all();
+	}
+
+	// Moves up to maxPages loaded pages into atlas slots, writing their texels to staging (maxPages * TILE_BYTES).
+	// Only pages no draw of the last processed frame used are evicted, if every slot is busy the rest waits.
+	// Returns the staged pages; the page table is up to date whenever any were returned.
+	std::vector<PageUpload> collectPages(unsigned char* staging, uint32_t maxPages)
+	{
+		std::vector<LoadedPage> ready;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			while (!loaded.empty() && ready.size() < maxPages)
+			{
+				ready.push_back(std::move(loaded.front()));
+				loaded.pop_front();
+			}
+		}
+
+		std::vector<PageUpload> uploads;
+		for (auto& page : ready)
+		{
+			uint32_t slot;
+			if (page.index == getPageCount() - 1)
+			{
+				slot = 0; // the root page, placed by open()
+			}
+			else if (!freeSlots.empty())
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else if (!lru.empty() && resident[lru.back()].lastUsed != frame)
+			{
+				uint32_t victim = lru.back();
+				lru.pop_back();
+				slot = resident[victim].slot;
+				resident.erase(victim);
+				stats.evictions++;
+			}
+			else
+			{
+				// Cache full with pages that are all in use, asked for again once something frees up
+				pending.erase(page.index);
+				continue;
+			}
+
+			if (page.index != getPageCount() - 1)
+			{
+				lru.push_front(page.index);
+				resident[page.index] = {slot, lru.begin(), frame};
+				pending.erase(page.index);
+			}
+
+			VkDeviceSize offset = uploads.size() * TILE_BYTES;
+			memcpy(staging + offset, page.texels.data(), TILE_BYTES);
+			uploads.push_back({slot % atlasPages, slot / atlasPages, offset});
+			stats.uploads++;
+		}
+
+		if (!uploads.empty())
+		{
+			buildPageTable();
+		}
+		return uploads;
+	}
+
+private:
+	struct Header
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t pageSize;
+		uint32_t border;
+		uint32_t levelCount;
+		uint32_t reserved;
+		uint64_t sourceStamp;
+	};
+	static_assert(sizeof(Header) == 40, "virtual texture header must be tightly packed");
+
+	static constexpr char MAGIC[4] = {'V', 'T', 'E', 'X'};
+	static constexpr uint32_t VERSION = 1;
+
+	struct ResidentPage
+	{
+		uint32_t slot;
+		std::list<uint32_t>::iterator lruPosition; // lru.end() for the root page, which is never evicted
+		uint64_t lastUsed; // frame
+	};
+
+	struct LoadedPage
+	{
+		uint32_t index;
+		std::vector<unsigned char> texels;
+	};
+
+	MappedFile file;
+	Header header{};
+	std::vector<uint32_t> levelOffsets;
+	uint32_t atlasPages = 0;
+	std::vector<uint32_t> freeSlots;
+	std::vector<PageTableEntry> pageTable;
+	Stats stats;
+	uint64_t frame = 0;
+
+	// main thread only
+	std::unordered_map<uint32_t, ResidentPage> resident;
+	std::unordered_set<uint32_t> pending; // queued, loading or loaded but not staged yet
+	std::list<uint32_t> lru; // most recently used first
+
+	// shared with the workers
+	std::vector<std::thread> workers;
+	std::deque<uint32_t> queue;
+	std::deque<LoadedPage> loaded;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+
+	static uint32_t roundUpToPowerOfTwo(uint32_t value)
+	{
+		uint32_t result = 1;
+		while (result < value) result <<= 1;
+		return result;
+	}
+
+	// Levels down to the first one that fits in a single page
+	static uint32_t getLevelCount(uint32_t width, uint32_t height)
+	{
+		uint32_t levelCount = 1;
+		while ((width >> (levelCount - 1)) > PAGE_SIZE || (height >> (levelCount - 1)) > PAGE_SIZE)
+		{
+			levelCount++;
+		}
+		return levelCount;
+	}
+
+	uint32_t getLevel(uint32_t page) const
+	{
+		uint32_t level = 0;
+		while (level + 1 < header.levelCount && page >= levelOffsets[level + 1]) level++;
+		return level;
+	}
+
+	const unsigned char* getPage(uint32_t page) const
+	{
+		return file.data() + sizeof(Header) + page * TILE_BYTES;
+	}
+
+	// Coarsest level first, so a missing page can copy the entry of its parent
+	void buildPageTable()
+	{
+		for (uint32_t level = header.levelCount; level-- > 0;)
+		{
+			uint32_t pagesX = getPagesX(level);
+			uint32_t pagesY = getPagesY(level);
+			for (uint32_t y = 0; y < pagesY; y++)
+			{
+				for (uint32_t x = 0; x < pagesX; x++)
+				{
+					uint32_t page = levelOffsets[level] + y * pagesX + x;
+					auto found = resident.find(page);
+					if (found != resident.end())
+					{
+						uint32_t slot = found->second.slot;
+						pageTable[page] = {static_cast<uint8_t>(slot % atlasPages),
+						                   static_cast<uint8_t>(slot / atlasPages), static_cast<uint8_t>(level), 1};
+					}
+					else
+					{
+						uint32_t parent = levelOffsets[level + 1] + (y / 2) * getPagesX(level + 1) + x / 2;
+						pageTable[page] = pageTable[parent];
+						pageTable[page].resident = 0;
+					}
+				}
+			}
+		}
+	}
+
+	void work()
+	{
+		while (true)
+		{
+			uint32_t page;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this]() { return stopping || !queue.empty(); });
+				if (stopping) return;
+				page = queue.front();
+				queue.pop_front();
+			}
+
+			// Touching the mapping is what reads the page from disk
+			LoadedPage result{page, std::vector<unsigned char>(getPage(page), getPage(page) + TILE_BYTES)};
+
+			std::lock_guard<std::mutex> lock(mutex);
+			loaded.push_back(std::move(result));
+		}
+	}
+};
+
+#endif /* VirtualTexture_h */
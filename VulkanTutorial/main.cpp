@@ -6,9 +6,87 @@
 //
 
 #include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
 #include "HelloTriangleApplication.h"
 
-int main() {
+// VulkanTutorial --convert-textures [directory] [--rgba8]
+// bakes the textures into KTX2 files instead of opening a window
+static int convertTextures(int argc, char** argv) {
+    std::string directory = "VulkanTutorial/content";
+    bool compress = true;
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--rgba8") {
+            compress = false;
+        } else {
+            directory = arg;
+        }
+    }
+
+    try {
+        HelloTriangleApplication::convertTextures(directory, compress);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// VulkanTutorial --benchmark-decode [directory...]
+// times texture decoding single threaded vs. on a worker pool
+static int benchmarkDecode(int argc, char** argv) {
+    std::vector<std::string> directories;
+    for (int i = 2; i < argc; i++) {
+        directories.push_back(argv[i]);
+    }
+    if (directories.empty()) {
+        directories = {"VulkanTutorial/image", "VulkanTutorial/content"};
+    }
+
+    try {
+        HelloTriangleApplication::benchmarkDecode(directories);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+// VulkanTutorial --build-virtual-texture <image> [output]
+// writes the tiled container the virtual texture streams its pages from, next to the image by default
+static int buildVirtualTexture(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "usage: VulkanTutorial --build-virtual-texture <image> [output]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string image = argv[2];
+    std::string output = argc > 3 ? argv[3] : std::filesystem::path(image).replace_extension(".vtex").string();
+
+    try {
+        HelloTriangleApplication::buildVirtualTexture(image, output);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--convert-textures") {
+        return convertTextures(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-decode") {
+        return benchmarkDecode(argc, argv);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--build-virtual-texture") {
+        return buildVirtualTexture(argc, argv);
+    }
+
     HelloTriangleApplication app;
 
     try {
@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// Every texture of the scene, see BindlessTextures.h
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// The same for the whole draw, so the index is dynamically uniform and needs no nonuniformEXT.
+// DrawConstants::material, behind the vertex stage's model matrix
+layout(push_constant) uniform Material {
+    layout(offset = 64) uint textureIndex;
+} material;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    outColor = texture(textures[material.textureIndex], fragTexCoord);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(push_constant) uniform Draw {
+    mat4 model;
+} draw;
+
+layout(location = 0) in vec3 inPosition;
+
+// must match Shader.vert bit for bit, the color pass tests against the prepass depth with EQUAL
+invariant gl_Position;
+
+void main() {
+    gl_Position = ubo.proj * ubo.view * draw.model * vec4(inPosition, 1.0);
+}
\ No newline at end of file
@@ -7,6 +7,32 @@ layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) out vec4 outColor;
 
+// ShaderFeature in HelloTriangleApplication.h. Specialized per pipeline, so the compiler drops the code of the
+// features that are off; the defaults are what the app draws with.
+// Compiled with UBER_SHADER they come from the push constants instead and every draw branches on them.
+#ifdef UBER_SHADER
+layout(push_constant) uniform Draw {
+    layout(offset = 68) uint features; // DrawConstants::features
+} draw;
+#define TEXTURE ((draw.features & 1u) != 0u)
+#define VERTEX_COLOR ((draw.features & 2u) != 0u)
+#define ALPHA_TEST ((draw.features & 4u) != 0u)
+#else
+layout(constant_id = 0) const bool TEXTURE = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = false;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+#endif
+
 void main() {
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 color = vec4(1.0);
+    if (TEXTURE) {
+        color = texture(texSampler, fragTexCoord);
+    }
+    if (VERTEX_COLOR) {
+        color.rgb *= fragColor;
+    }
+    if (ALPHA_TEST && color.a < 0.5) {
+        discard;
+    }
+    outColor = color;
 }
\ No newline at end of file
@@ -0,0 +1,55 @@
+#version 450
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+
+// See VirtualTexture.h: one page table texel per page, one page table level per texture level
+layout(binding = 2) uniform usampler2D pageTable;
+layout(binding = 3) uniform sampler2D pageAtlas;
+
+// Every page this frame needs, read back by the CPU
+layout(binding = 4) buffer Feedback {
+    uint requested[];
+} feedback;
+
+layout(location = 0) out vec4 outColor;
+
+const int PAGE_SIZE = 128;
+const int BORDER = 4;
+const int TILE_SIZE = PAGE_SIZE + 2 * BORDER;
+
+ivec2 levelSize(ivec2 size, int level) {
+    return max(size >> level, ivec2(1));
+}
+
+void main() {
+    ivec2 pages = textureSize(pageTable, 0);
+    ivec2 size = pages * PAGE_SIZE;
+    int levels = textureQueryLevels(pageTable);
+
+    // Same level selection the hardware would do for a fully mipmapped texture
+    vec2 texel = fragTexCoord * vec2(size);
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+    int level = min(int(lod), levels - 1);
+
+    // Repeat addressing, like the tiles were built with
+    ivec2 page = ivec2(mod(fragTexCoord * vec2(levelSize(size, level)), vec2(levelSize(size, level)))) / PAGE_SIZE;
+
+    uint index = 0u;
+    for (int i = 0; i < level; i++) {
+        ivec2 levelPages = levelSize(pages, i);
+        index += uint(levelPages.x * levelPages.y);
+    }
+    index += uint(page.y * levelSize(pages, level).x + page.x);
+    feedback.requested[index] = 1u;
+
+    // The entry points at the page itself or at its closest resident ancestor, z is the level of what is in the slot
+    uvec4 entry = texelFetch(pageTable, page, level);
+    vec2 residentSize = vec2(levelSize(size, int(entry.z)));
+    vec2 residentTexel = mod(fragTexCoord * residentSize, residentSize);
+    vec2 inPage = residentTexel - floor(residentTexel / PAGE_SIZE) * PAGE_SIZE;
+    vec2 atlasTexel = vec2(entry.xy) * TILE_SIZE + BORDER + inPage;
+    outColor = textureLod(pageAtlas, atlasTexel / vec2(textureSize(pageAtlas, 0)), 0.0);
+}
@@ -1,2 +1,6 @@
 glslc ./VulkanTutorial/shader/Shader.vert -o ./VulkanTutorial/shader/vert.spv
-glslc ./VulkanTutorial/shader/Shader.frag -o ./VulkanTutorial/shader/frag.spv
\ No newline at end of file
+glslc ./VulkanTutorial/shader/Shader.frag -o ./VulkanTutorial/shader/frag.spv
+glslc ./VulkanTutorial/shader/Depth.vert -o ./VulkanTutorial/shader/depth.spv
+glslc ./VulkanTutorial/shader/Downsample.comp -o ./VulkanTutorial/shader/downsample.spv
+glslc ./VulkanTutorial/shader/Bindless.frag -o ./VulkanTutorial/shader/bindless.spv
+glslc ./VulkanTutorial/shader/VirtualTexture.frag -o ./VulkanTutorial/shader/virtual.spv
\ No newline at end of file